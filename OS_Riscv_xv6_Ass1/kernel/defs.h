@@ -1,10 +1,15 @@
 struct buf;
 struct context;
 struct file;
+struct hrtimer;
 struct inode;
 struct pipe;
 struct proc;
+struct rbnode;
+struct rbroot;
+struct rqtree;
 struct spinlock;
+struct waitq;
 struct sleeplock;
 struct stat;
 struct superblock;
@@ -82,6 +87,7 @@ void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
 // proc.c
+extern int      nharts;
 int             cpuid(void);
 void            exit(int, char *);
 int             fork(void);
@@ -102,6 +108,8 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64, uint64);
 void            wakeup(void*);
+void            wakeup_one(void*);
+void            waitqinit(void);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
@@ -109,7 +117,42 @@ void            procdump(void);
 void            set_ps_priority(int ps);        // Task 5
 void            set_cfs_priority(int priority); // Task 6
 void            get_cfs_stats(int pid, uint64); // Task 6
-void            set_policy(int);                // Task 7
+int             get_proc_stats(uint64, int);
+int             get_sched_latency(uint64);
+int             get_wakeup_stats(uint64);
+
+// runq.c
+void            runqinit(void);
+int             set_policy(int);                // Task 7
+int             sched_tick(struct proc*);
+int             resched_pending(void);
+void            sched_start(struct proc*);
+void            rq_enqueue(struct proc*, int);
+void            rq_dequeue(struct proc*);
+struct proc*    rq_pick(void);
+int             rq_any(void);
+void            rqtree_insert(struct rqtree*, struct rbnode*, long long (*)(struct rbnode*));
+void            rqtree_remove(struct rqtree*, struct rbnode*);
+
+// sched_edf.c
+void            edfinit(void);
+int             set_deadline(uint64, uint64, uint64);
+
+// rbtree.c
+void            rb_link(struct rbnode*, struct rbnode*, struct rbnode**);
+void            rb_insert(struct rbroot*, struct rbnode*);
+void            rb_erase(struct rbroot*, struct rbnode*);
+struct rbnode*  rb_first(struct rbroot*);
+struct rbnode*  rb_next(struct rbnode*);
+
+// hrtimer.c
+void            hrtimerinit(void);
+void            hrtimer_init(struct hrtimer*, void (*)(struct hrtimer*));
+void            hrtimer_start(struct hrtimer*, uint64);
+int             hrtimer_cancel(struct hrtimer*);
+int             hrtimer_active(struct hrtimer*);
+void            hrtimer_interrupt(void);
+int             hrsleep(uint64);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -146,11 +189,11 @@ int             fetchaddr(uint64, uint64*);
 void            syscall();
 
 // trap.c
-extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
+void            tickstart(void);
 void            usertrapret(void);
+void            ipi(int);
 
 // uart.c
 void            uartinit(void);
@@ -0,0 +1,195 @@
+// High-resolution timers.
+//
+// Each hart keeps the timers armed on it in a red-black tree by
+// expiry time, and programs its CLINT mtimecmp for the earliest
+// one. timervec in kernelvec.S disarms mtimecmp when it fires and
+// forwards the interrupt, and hrtimer_interrupt() runs what is due
+// and programs the next event. So a hart takes a timer interrupt
+// only when one of its timers expires: the scheduler tick (trap.c)
+// runs only while the hart has a process to preempt, and sleeping
+// processes are woken at their own deadline, to the clock's
+// resolution, instead of by every tick.
+//
+// A timer is armed on the hart that calls hrtimer_start(), since
+// a hart can only program its own mtimecmp; it can be cancelled
+// from anywhere.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+static struct spinlock hrsleeplock;
+
+static struct hrtimer*
+timerof(struct rbnode *n)
+{
+  return (struct hrtimer*)((char*)n - (uint64)&((struct hrtimer*)0)->node);
+}
+
+void
+hrtimerinit(void)
+{
+  struct cpu *c;
+
+  initlock(&hrsleeplock, "hrsleep");
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    initlock(&c->tq.lock, "hrtimerq");
+    c->tq.root.node = c->tq.first = 0;
+  }
+}
+
+void
+hrtimer_init(struct hrtimer *t, void (*fn)(struct hrtimer*))
+{
+  t->fn = fn;
+  t->q = 0;
+  t->expires = 0;
+}
+
+// Caller must hold q->lock.
+static void
+enqueue(struct hrtimerq *q, struct hrtimer *t)
+{
+  struct rbnode **link = &q->root.node;
+  struct rbnode *parent = 0;
+  int first = 1;
+
+  while(*link){
+    parent = *link;
+    if(t->expires < timerof(parent)->expires){
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      first = 0;
+    }
+  }
+  rb_link(&t->node, parent, link);
+  rb_insert(&q->root, &t->node);
+  if(first)
+    q->first = &t->node;
+  t->q = q;
+}
+
+// Caller must hold q->lock.
+static void
+dequeue(struct hrtimerq *q, struct hrtimer *t)
+{
+  if(q->first == &t->node)
+    q->first = rb_next(&t->node);
+  rb_erase(&q->root, &t->node);
+  t->q = 0;
+}
+
+// Program this hart's mtimecmp for the earliest timer in q,
+// its own queue. Caller must hold q->lock.
+static void
+program(struct hrtimerq *q)
+{
+  uint64 next = q->first ? timerof(q->first)->expires : ~0ULL;
+
+  *(volatile uint64*)CLINT_MTIMECMP(cpuid()) = next;
+}
+
+// Disarm t. Returns 1 if it was armed, 0 if it had
+// expired or was never started.
+int
+hrtimer_cancel(struct hrtimer *t)
+{
+  struct hrtimerq *q;
+
+  // t->q can change until we hold its lock.
+  while((q = t->q) != 0){
+    acquire(&q->lock);
+    if(t->q == q){
+      dequeue(q, t);
+      release(&q->lock);
+      return 1;
+    }
+    release(&q->lock);
+  }
+  return 0;
+}
+
+// Arm t to fire at expires on this hart, disarming
+// it first if it is already armed.
+void
+hrtimer_start(struct hrtimer *t, uint64 expires)
+{
+  struct hrtimerq *q;
+
+  hrtimer_cancel(t);
+  push_off();
+  q = &mycpu()->tq;
+  acquire(&q->lock);
+  t->expires = expires;
+  enqueue(q, t);
+  if(q->first == &t->node)
+    program(q);
+  release(&q->lock);
+  pop_off();
+}
+
+int
+hrtimer_active(struct hrtimer *t)
+{
+  return t->q != 0;
+}
+
+// Run this hart's expired timers and program the next one.
+// Called from devintr() with interrupts off.
+void
+hrtimer_interrupt(void)
+{
+  struct hrtimerq *q = &mycpu()->tq;
+  uint64 now = r_time();
+  struct hrtimer *t;
+
+  acquire(&q->lock);
+  while(q->first && (t = timerof(q->first))->expires <= now){
+    dequeue(q, t);
+    release(&q->lock);
+    t->fn(t);
+    acquire(&q->lock);
+  }
+  // if the next one is already due, the CLINT
+  // interrupts again as soon as we return.
+  program(q);
+  release(&q->lock);
+}
+
+static void
+hrsleepwake(struct hrtimer *t)
+{
+  acquire(&hrsleeplock);
+  wakeup(t);
+  release(&hrsleeplock);
+}
+
+// Sleep until mtime reaches deadline.
+// Returns -1 if the process is killed first.
+int
+hrsleep(uint64 deadline)
+{
+  struct proc *p = myproc();
+  struct hrtimer *t = &p->sleeptimer;
+
+  acquire(&hrsleeplock);
+  t->fn = hrsleepwake;
+  hrtimer_start(t, deadline);
+  while(r_time() < deadline){
+    if(killed(p)){
+      release(&hrsleeplock);
+      hrtimer_cancel(t);
+      return -1;
+    }
+    sleep(t, &hrsleeplock);
+  }
+  release(&hrsleeplock);
+  // the deadline can pass before the interrupt is taken.
+  hrtimer_cancel(t);
+  return 0;
+}
@@ -0,0 +1,15 @@
+// High-resolution one-shot timers; see hrtimer.c.
+// expires is an absolute CLINT mtime value.
+struct hrtimer {
+  struct rbnode node;           // Link in q->root, while armed.
+  uint64 expires;
+  void (*fn)(struct hrtimer*);  // Called with interrupts off and no locks held.
+  struct hrtimerq *q;           // Queue it is armed on, or null.
+};
+
+// Per-CPU timer queue, ordered by expiry time.
+struct hrtimerq {
+  struct spinlock lock;
+  struct rbroot root;
+  struct rbnode *first;         // Earliest armed timer, or null.
+};
@@ -11,3 +11,8 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define NSCHEDHIST   16  // buckets in the scheduling latency histogram
+#define NWAITQ       61  // sleep()/wakeup() hash buckets
+#define TIMEBASE     10000000  // CLINT mtime frequency in qemu, Hz
+#define TICKCYCLES   (TIMEBASE/10)  // scheduler tick, in mtime cycles
+#define IDLEPOLL     (10*TICKCYCLES)  // how often an idle hart looks for work to steal
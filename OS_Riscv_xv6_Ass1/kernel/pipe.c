@@ -82,11 +82,14 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
   acquire(&pi->lock);
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
+      // we may have been handed the turn; pass it on.
+      if(pi->nwrite != pi->nread + PIPESIZE)
+        wakeup_one(&pi->nwrite);
       release(&pi->lock);
       return -1;
     }
     if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
+      wakeup_one(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
       char ch;
@@ -96,7 +99,10 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       i++;
     }
   }
-  wakeup(&pi->nread);
+  wakeup_one(&pi->nread);
+  // pass the turn on to the next writer if there is room.
+  if(pi->nwrite != pi->nread + PIPESIZE)
+    wakeup_one(&pi->nwrite);
   release(&pi->lock);
 
   return i;
@@ -124,7 +130,10 @@ piperead(struct pipe *pi, uint64 addr, int n)
     if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
       break;
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  wakeup_one(&pi->nwrite);  //DOC: piperead-wakeup
+  // pass the turn on to the next reader if data is left.
+  if(pi->nread != pi->nwrite)
+    wakeup_one(&pi->nread);
   release(&pi->lock);
   return i;
 }
@@ -4,6 +4,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "pstat.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -15,12 +16,12 @@ struct proc *initproc;
 int nextpid = 1;
 struct spinlock pid_lock;
 
+int nharts;   // harts that have entered scheduler().
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
 void set_ps_priority(int priority);         // Task 5
 void set_cfs_priority(int priority);        // Task 6
-void timerUpdate(void);                     // Task 6 helper function
-int sched_policy = 0;                       // As requested in Task 7
 
 extern char trampoline[]; // trampoline.S
 
@@ -60,6 +61,8 @@ procinit(void)
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
   }
+  runqinit();
+  waitqinit();
 }
 
 // Must be called with interrupts disabled,
@@ -106,6 +109,26 @@ allocpid()
   return pid;
 }
 
+// Task 6: move p to state s, charging the time since its
+// last change to the state it leaves. Statistics are kept only
+// here, at state changes, so the timer tick does no work for them.
+// Caller must hold p->lock.
+static void
+setstate(struct proc *p, enum procstate s)
+{
+  uint64 now = r_time();
+  uint64 d = now - p->stamp;
+
+  if(p->state == RUNNING)
+    p->rtime += d;
+  else if(p->state == RUNNABLE)
+    p->retime += d;
+  else if(p->state == SLEEPING)
+    p->stime += d;
+  p->stamp = now;
+  p->state = s;
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -158,30 +181,38 @@ found:
   p->stime = 0;
   p->rtime = 0;
   p->retime = 0;
+  p->stamp = r_time();
+  p->nvcsw = 0;
+  p->nivcsw = 0;
   p->cfs_priority = 100;
+  p->vruntime = 0;
+  p->cpu = -1;
+  p->rq = 0;
+  p->dl_runtime = p->dl_deadline = p->dl_period = 0;
+  p->dl_bw = 0;
+  p->dl_misses = 0;
+  p->dl_missed = 0;
   return p;
 }
 
 // Task 5 :
 // This is a helper function that finds the RUNNING/RUNNABLE procces
-// with the minimal accumulator value and returns said value.
+// other than pp with the minimal accumulator value and returns said value.
 // if there are'nt any, returns 0, as requested in the task.
+// It reads the minimum each hart caches for its run queue and its
+// running process without locks (see runq.c); the result only
+// steers fairness, so a slightly stale value is harmless.
 long long
 minAccumulator(struct proc *pp){
-  struct proc *p;
-  long long min = 9223372036854775807;
-  int counter = 0;
-  for(p = proc; p < &proc[NPROC]; p++){
-    if(p != pp){
-      acquire(&p->lock); 
-    if((p->state == RUNNABLE || p->state == RUNNING) && p->accumulator < min){
-      counter++;
-      min = p->accumulator;
-    }
-    release(&p->lock);
-    }
+  struct cpu *c;
+  long long min = ACCMAX;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->rq.minacc < min)
+      min = c->rq.minacc;
+    if(c->proc != pp && c->runacc < min)
+      min = c->runacc;
   }
-  return counter == 0 ? 0 : min;
+  return min == ACCMAX ? 0 : min;
 }
 
 // free a proc structure and the data hanging from it,
@@ -284,7 +315,8 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setstate(p, RUNNABLE);
+  rq_enqueue(p, 0);
 
   release(&p->lock);
 }
@@ -353,13 +385,11 @@ fork(void)
   np->parent = p;
   release(&wait_lock);
 
-  acquire(&np->lock);
-  np->state = RUNNABLE;
-  release(&np->lock);
-
   // Task 6 : as requested in the task.
   acquire(&np->lock);
-  np->cfs_priority = np->parent->cfs_priority;
+  np->cfs_priority = p->cfs_priority;
+  setstate(np, RUNNABLE);
+  rq_enqueue(np, 0);
   release(&np->lock);
 
   return pid;
@@ -404,6 +434,9 @@ exit(int status, char* msg)
   end_op();
   p->cwd = 0;
 
+  // give back any EDF reservation.
+  set_deadline(0, 0, 0);
+
   acquire(&wait_lock);
 
   // Give any children to init.
@@ -415,7 +448,7 @@ exit(int status, char* msg)
   acquire(&p->lock);
 
   p->xstate = status;
-  p->state = ZOMBIE;
+  setstate(p, ZOMBIE);
 
   release(&wait_lock);
 
@@ -497,27 +530,132 @@ void set_cfs_priority(int n){
   release(&p->lock);
 }
 
-// Task 6:
+// Fill in *ps from p, counting the time p has
+// spent in its current state so far.
+// Caller must hold p->lock.
+static void
+snapstats(struct proc *p, struct pstat *ps)
+{
+  uint64 d = r_time() - p->stamp;
+
+  ps->pid = p->pid;
+  ps->state = p->state;
+  ps->cpu = p->cpu;
+  safestrcpy(ps->name, p->name, sizeof(ps->name));
+  ps->rtime = p->rtime + (p->state == RUNNING ? d : 0);
+  ps->retime = p->retime + (p->state == RUNNABLE ? d : 0);
+  ps->stime = p->stime + (p->state == SLEEPING ? d : 0);
+  ps->nvcsw = p->nvcsw;
+  ps->nivcsw = p->nivcsw;
+  ps->dlmiss = p->dl_misses;
+}
+
+// Task 6: cfs_priority and the run, ready and sleep
+// times of process pid, in ticks.
 void
 get_cfs_stats(int pid, uint64 addr){
   struct proc* pp;
+  struct pstat ps;
   int d[4];
   for(pp = proc; pp < &proc[NPROC]; pp++){
     acquire(&pp->lock);
     if(pp->pid == pid){
+      snapstats(pp, &ps);
       d[0] = pp->cfs_priority;
-      d[1] = pp->retime;
-      d[2] = pp->rtime;
-      d[3] = pp->stime;
-      copyout(pp->pagetable,addr, (char*)&d, sizeof(d));
+      d[1] = ps.retime / TICKCYCLES;
+      d[2] = ps.rtime / TICKCYCLES;
+      d[3] = ps.stime / TICKCYCLES;
+      release(&pp->lock);
+      copyout(myproc()->pagetable, addr, (char*)&d, sizeof(d));
+      return;
     }
     release(&pp->lock);
   }
 }
 
-// Task 7:
-void set_policy(int policy){
-  sched_policy = policy;
+// Copy the statistics of up to n live processes to the
+// array of struct pstat at user address addr, all in one
+// pass. Returns how many were copied, or -1.
+int
+get_proc_stats(uint64 addr, int n)
+{
+  struct proc *p;
+  struct pstat ps;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      continue;
+    }
+    snapstats(p, &ps);
+    release(&p->lock);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(ps), (char*)&ps, sizeof(ps)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
+// Record how long the scheduler took to choose a process,
+// counted since t0, in this CPU's log2 histogram.
+static void
+pickstat(struct cpu *c, uint64 t0)
+{
+  uint64 d = r_time() - t0;
+  int b = 0;
+
+  while(d > 1 && b < NSCHEDHIST-1){
+    d >>= 1;
+    b++;
+  }
+  c->pickhist[b]++;
+}
+
+// Copy the scheduling latency histogram, summed over all
+// CPUs, to user address addr and start a new one.
+int
+get_sched_latency(uint64 addr)
+{
+  uint hist[NSCHEDHIST];
+  struct cpu *c;
+  int i;
+
+  memset(hist, 0, sizeof(hist));
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    for(i = 0; i < NSCHEDHIST; i++){
+      hist[i] += c->pickhist[i];
+      c->pickhist[i] = 0;
+    }
+  }
+  return copyout(myproc()->pagetable, addr, (char*)hist, sizeof(hist));
+}
+
+// The idle poll timer has nothing to do but
+// bring the hart out of wfi.
+static void
+idlewake(struct hrtimer *t)
+{
+}
+
+// Nothing to run: wait in wfi for an interrupt, without
+// the scheduler tick (it stops re-arming when there is no
+// process), unless some hart's queue has a process to steal.
+// Sleeping with interrupts off means one that arrives after
+// the check below still ends the wfi.
+static void
+idle(struct cpu *c)
+{
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();   // pairs with rq_enqueue().
+  if(!rq_any()){
+    if(!hrtimer_active(&c->idlepoll))
+      hrtimer_start(&c->idlepoll, r_time() + IDLEPOLL);
+    asm volatile("wfi");
+  }
+  c->idle = 0;
 }
 
 // Per-CPU process scheduler.
@@ -531,112 +669,40 @@ void
 scheduler(void)
 {
   struct proc *p;
-  struct proc *pa; // This is for task 5
-  struct proc *pp; // This is for task 6
   struct cpu *c = mycpu();
+  uint64 t0;
   
   c->proc = 0;
+  hrtimer_init(&c->idlepoll, idlewake);
+  __sync_fetch_and_add(&nharts, 1);
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-  if(sched_policy == 0){ // Here starts the original xv6-riscv scheduler implmentation
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
-  } // Here ends the original xv6-riscv scheduler implmentation
-
-  else if(sched_policy == 1){ // Here starts implmentation of Task 5
-  pa = proc; 
-  long long min = -1;
-  for(p = proc; p < &proc[NPROC]; p++){ // find the minimal accumulator value
-    acquire(&p->lock);
-    if(p->state == RUNNABLE && (p->accumulator < min || min == -1)){  
-        pa = p;   
-        min = p->accumulator;
-    }
-    release(&p->lock);
-  } 
-
-  // try to run the process with the minimal accumulator value:
-  acquire(&pa->lock);
-  if(pa->state == RUNNABLE) {
-    // Switch to chosen process.  It is the process's job
-    // to release its lock and then reacquire it
-    // before jumping back to us.
-    pa->state = RUNNING;
-    c->proc = pa;
-    swtch(&c->context, &pa->context);
-
-    // Process is done running for now.
-    // It should have changed its p->state before coming back.
-    c->proc = 0;
-  }
-  release(&pa->lock);
-
-  } // Here ends implmentation of Task 5
-
-  else if(sched_policy == 2){ // Here starts implmentation of Task 6
-
-  // calculate the vruntime of the first process in the procces table, for comparison.
-  int vruntime = (proc->cfs_priority)*((proc->rtime)/(proc->rtime + proc->stime + proc->retime));
-
-  // find the RUNNABLE process with the minimal vruntime.
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->state == RUNNABLE){
-    int currVruntime = (p->cfs_priority)*((p->rtime)/(p->rtime + p->stime + p->retime));
-    if(currVruntime < vruntime)
-        vruntime = currVruntime;
-    }
-    release(&p->lock);
-  }
-
-    // find the first process in the table that has the minimal vruntime that we found.
-    // if possible, try to run it.
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      int currVruntime = (p->cfs_priority)*((p->rtime)/(p->rtime + p->stime + p->retime));
-      if(p->state == RUNNABLE && vruntime <= currVruntime) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
+    // Task 5, 6 and 7: rq_pick() chooses by the scheduling
+    // class set_policy() selected. See runq.c.
+    t0 = r_time();
+    if((p = rq_pick()) != 0){
+      pickstat(c, t0);
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      setstate(p, RUNNING);
+      p->cpu = cpuid();
+      c->proc = p;
+      c->runacc = p->accumulator;
+      sched_start(p);
+      tickstart();
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->runacc = ACCMAX;
+      c->proc = 0;
       release(&p->lock);
-
-      // calculate minimal vruntime again for comparison later on in the loop.
-      vruntime = (proc->cfs_priority)*((proc->rtime)/(proc->rtime + proc->stime + proc->retime));
-      for(pp = proc; pp < &proc[NPROC]; pp++){
-        acquire(&pp->lock);
-        if(p->state == RUNNABLE){
-          currVruntime = (pp->cfs_priority)*((pp->rtime)/(pp->rtime + pp->stime + pp->retime));
-        if(currVruntime < vruntime)
-            vruntime = currVruntime;
-        }
-        release(&pp->lock);
-      }
+    } else {
+      idle(c);
     }
-  } // Here ends implmentation of Task 6
   }
 }
 
@@ -673,7 +739,9 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setstate(p, RUNNABLE);
+  p->nivcsw++;
+  rq_enqueue(p, 0);
   sched();
   release(&p->lock);
 }
@@ -699,69 +767,174 @@ forkret(void)
   usertrapret();
 }
 
+// Sleeping processes wait in a table of queues hashed by chan,
+// so that wakeup() looks only at processes sleeping on channels
+// that hash alike instead of locking every process.
+// A queue's lock protects its list and the p->wq and p->wqnext
+// of the processes on it; p->lock must also be held to change
+// p->wq. Lock order: the sleeper's condition lock, then the
+// queue lock, then p->lock.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;    // oldest sleeper first
+};
+
+static struct waitq waitq[NWAITQ];
+
+static struct waitq*
+chanq(void *chan)
+{
+  uint64 h = (uint64)chan;
+
+  h ^= h >> 12;
+  return &waitq[(h >> 3) % NWAITQ];
+}
+
+void
+waitqinit(void)
+{
+  struct waitq *wq;
+
+  for(wq = waitq; wq < &waitq[NWAITQ]; wq++){
+    initlock(&wq->lock, "waitq");
+    wq->head = 0;
+  }
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = chanq(chan);
+  struct proc **pp;
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Once we hold wq->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks wq->lock),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
-  // Go to sleep.
+  // Go to sleep, at the tail of the queue.
   p->chan = chan;
-  p->state = SLEEPING;
+  setstate(p, SLEEPING);
+  p->nvcsw++;
+  for(pp = &wq->head; *pp; pp = &(*pp)->wqnext)
+    ;
+  *pp = p;
+  p->wqnext = 0;
+  p->wq = wq;
+  release(&wq->lock);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  wq = p->wq;
+  release(&p->lock);
+
+  // wakeup() unlinks the processes it wakes, but kill() leaves
+  // them queued. Nobody else unlinks a process that is not
+  // SLEEPING, so p->wq cannot change under us here.
+  if(wq){
+    acquire(&wq->lock);
+    for(pp = &wq->head; *pp != p; pp = &(*pp)->wqnext)
+      ;
+    *pp = p->wqnext;
+    acquire(&p->lock);
+    p->wq = 0;
+    release(&p->lock);
+    release(&wq->lock);
+  }
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
-// Wake up all processes sleeping on chan.
+// Wake up processes sleeping on chan: all of them,
+// or only the one that has waited longest if one is set.
 // Must be called without any p->lock.
-void
-wakeup(void *chan)
+static void
+wakechan(void *chan, int one)
 {
   // As requested in Task 5, set the accumulator values for every process that gets a wakeup call
-  // to the current minimal accumulator value.
+  // to the current minimal accumulator value. Computed only once someone is found.
   long long min = -1;
-  struct proc *p;
-  for (p = proc; p < &proc[NPROC]; p++)
-  {
-    if(p != myproc()){
+  struct waitq *wq = chanq(chan);
+  struct proc *p, **pp;
+  struct cpu *c;
+  uint locks = 1;
+
+  acquire(&wq->lock);
+  pp = &wq->head;
+  while((p = *pp) != 0){
     acquire(&p->lock);
-    if ((p->state == RUNNABLE || p->state == RUNNING) && (p->accumulator < min || min == -1 ))
-    {
-      min = p->accumulator;
-    }
-    release(&p->lock);
-  }
-  }
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
+    locks++;
+    if(p->state == SLEEPING && p->chan == chan) {
+      *pp = p->wqnext;
+      p->wq = 0;
       if(min < 0)
-        min = 0;
+        min = minAccumulator(myproc());
       p->accumulator = min;
+      setstate(p, RUNNABLE);
+      rq_enqueue(p, 1);
       release(&p->lock);
+      if(one)
+        break;
+      continue;
     }
+    release(&p->lock);
+    pp = &p->wqnext;
+  }
+  release(&wq->lock);
+
+  push_off();
+  c = mycpu();
+  c->nwakeup++;
+  c->nwakeuplock += locks;
+  pop_off();
+}
+
+// Wake up all processes sleeping on chan.
+// Must be called without any p->lock.
+void
+wakeup(void *chan)
+{
+  wakechan(chan, 0);
+}
+
+// Wake up one process sleeping on chan, for callers
+// where every sleeper waits for the same thing and only
+// one of them can use it.
+// Must be called without any p->lock.
+void
+wakeup_one(void *chan)
+{
+  wakechan(chan, 1);
+}
+
+// Copy the number of wakeup() calls and the locks they
+// acquired, summed over all CPUs, to user address addr,
+// and start counting again.
+int
+get_wakeup_stats(uint64 addr)
+{
+  uint st[2];
+  struct cpu *c;
+
+  st[0] = st[1] = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    st[0] += c->nwakeup;
+    st[1] += c->nwakeuplock;
+    c->nwakeup = c->nwakeuplock = 0;
   }
+  return copyout(myproc()->pagetable, addr, (char*)st, sizeof(st));
 }
 
 // Kill the process with the given pid.
@@ -778,7 +951,8 @@ kill(int pid)
       p->killed = 1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        setstate(p, RUNNABLE);
+        rq_enqueue(p, 1);
       }
       release(&p->lock);
       return 0;
@@ -866,20 +1040,3 @@ procdump(void)
     printf("\n");
   }
 }
-
-// Task 6: this is a helper function that updates one of the process's vruntime fields,
-// according to its current state.
-void timerUpdate()
-{
-  struct proc *p;
-    for(p = proc;p < &proc[NPROC];p++){
-      acquire(&p->lock);
-      if (p->state == RUNNING)
-        p->rtime++; 
-      else if (p->state == RUNNABLE)
-        p->retime++; 
-      else if (p->state == SLEEPING)
-        p->stime++;
-      release(&p->lock);
-  }
-}
\ No newline at end of file
@@ -1,3 +1,6 @@
+#include "rbtree.h"
+#include "hrtimer.h"
+
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -18,12 +21,63 @@ struct context {
   uint64 s11;
 };
 
+#define ACCMAX 9223372036854775807LL   // no accumulator (Task 5)
+
+// A red-black tree that caches its smallest node.
+struct rqtree {
+  struct rbroot root;
+  struct rbnode *leftmost;
+};
+
+struct runq;
+struct proc;
+
+// A scheduling class: one policy's ordering of a run queue.
+// set_policy() n selects sched_classes[n]; see runq.c.
+struct sched_class {
+  char *name;
+  // With rq->lock held:
+  void (*enqueue)(struct runq*, struct proc*);
+  void (*dequeue)(struct runq*, struct proc*);
+  struct proc* (*pick_next)(struct runq*);  // Next to run, left queued; or 0.
+  // With p->lock held, p RUNNING:
+  int (*tick)(struct proc*);                // Charge p a tick; 1 to preempt it.
+  void (*start)(struct proc*);              // p is about to run; may be null.
+};
+
+// Per-CPU run queue: the RUNNABLE processes waiting for this
+// hart, indexed by the current class. See runq.c.
+struct runq {
+  struct spinlock lock;
+  struct sched_class *class;  // Policy the queue is ordered by.
+  int nr;                     // Number of queued processes.
+  struct proc *head;          // FIFO order (sched_rr.c).
+  struct proc *tail;
+  struct rqtree acc;          // By accumulator (sched_prio.c).
+  long long minacc;           // Smallest queued accumulator, or ACCMAX.
+  struct rqtree cfs;          // By vruntime (sched_cfs.c).
+  long long min_vruntime;     // Monotonic floor for newly queued processes.
+  struct rqtree edf;          // Reserved processes by deadline (sched_edf.c).
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct runq rq;             // Processes waiting for this hart.
+  long long runacc;           // Accumulator of proc, or ACCMAX if idle.
+  uint pickhist[NSCHEDHIST];  // log2 histogram of scheduling decision latency.
+  uint nwakeup;               // wakeup() calls made on this hart.
+  uint nwakeuplock;           // Locks those calls acquired.
+  struct hrtimerq tq;         // Timers armed on this hart. See hrtimer.c.
+  struct hrtimer tick;        // Scheduler tick, armed while there is a proc.
+  struct hrtimer idlepoll;    // Wakes the hart from wfi to look for work.
+  int ticked;                 // Did this interrupt include the tick?
+  int resched;                // A class wants proc preempted; see sched_tick().
+  struct hrtimer dltimer;     // End of the running process's EDF budget.
+  int idle;                   // Waiting in wfi with an empty run queue.
 };
 
 extern struct cpu cpus[NCPU];
@@ -95,9 +149,31 @@ struct proc {
   long long accumulator;         // accumulated value of the process (Task 5)
   int ps_priority;               // process's priority indicator (Task 5)
   int cfs_priority;               // As requested in Task 6
-  int rtime;                      // As requested in Task 6
-  int stime;                      // As requested in Task 6
-  int retime;                     // As requested in Task 6
+  uint64 rtime;                   // As requested in Task 6, cycles RUNNING
+  uint64 stime;                   // As requested in Task 6, cycles SLEEPING
+  uint64 retime;                  // As requested in Task 6, cycles RUNNABLE
+  uint64 stamp;                   // mtime of the last state change
+  uint nvcsw;                     // Voluntary context switches
+  uint nivcsw;                    // Involuntary context switches
+  long long vruntime;             // Weighted run time, in 1/100 ticks.
+  int cpu;                        // Hart p last ran on, or -1.
+  struct runq *rq;                // Run queue p waits on, or null.
+  struct proc *rqnext;            // FIFO links in rq.
+  struct proc *rqprev;
+  struct rbnode accnode;          // Link in rq->acc.
+  struct rbnode cfsnode;          // Link in rq->cfs.
+  uint64 dl_runtime;              // EDF reservation, in mtime cycles:
+  uint64 dl_deadline;             //   runtime every period, due deadline
+  uint64 dl_period;               //   after release. 0 if not reserved.
+  int dl_bw;                      // runtime/period, in 1/1000 of a hart.
+  uint64 dl_abs;                  // Absolute deadline of the current job.
+  uint64 dl_rtime0;               // rtime when the budget was last replenished.
+  uint dl_misses;                 // Jobs that ran after their deadline.
+  uint64 dl_missed;               // dl_abs of the last job counted there.
+  struct rbnode edfnode;          // Link in rq->edf.
+  struct waitq *wq;               // Wait queue p sleeps on, or null.
+  struct proc *wqnext;            // Next sleeper in wq.
+  struct hrtimer sleeptimer;      // Deadline of sleep()/usleep().
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -113,6 +189,4 @@ struct proc {
   char name[16];               // Process name (debugging)
 };
 
-long long minAccumulator(struct proc *p);
-
-void timerUpdate(void);
\ No newline at end of file
+long long minAccumulator(struct proc *p);
\ No newline at end of file
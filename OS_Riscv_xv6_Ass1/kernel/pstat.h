@@ -0,0 +1,15 @@
+// Scheduler statistics for one process, as copied out by
+// get_proc_stats(). Times are in CLINT mtime cycles
+// (TIMEBASE per second), accumulated at state changes.
+struct pstat {
+  int pid;
+  int state;         // enum procstate
+  int cpu;           // Hart it last ran on, or -1
+  char name[16];
+  uint64 rtime;      // Time RUNNING
+  uint64 retime;     // Time RUNNABLE, waiting for a hart
+  uint64 stime;      // Time SLEEPING
+  uint nvcsw;        // Voluntary switches: sleep()
+  uint nivcsw;       // Involuntary switches: preempted by the tick
+  uint dlmiss;       // EDF jobs started after their deadline
+};
@@ -0,0 +1,256 @@
+// Red-black tree balancing, after CLRS chapter 13.
+// Null children stand in for the black sentinel leaves.
+// The caller provides all locking.
+
+#include "types.h"
+#include "riscv.h"
+#include "rbtree.h"
+#include "defs.h"
+
+static void
+rotate_left(struct rbroot *root, struct rbnode *x)
+{
+  struct rbnode *y = x->right;
+
+  x->right = y->left;
+  if(y->left)
+    y->left->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    root->node = y;
+  else if(x == x->parent->left)
+    x->parent->left = y;
+  else
+    x->parent->right = y;
+  y->left = x;
+  x->parent = y;
+}
+
+static void
+rotate_right(struct rbroot *root, struct rbnode *x)
+{
+  struct rbnode *y = x->left;
+
+  x->left = y->right;
+  if(y->right)
+    y->right->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    root->node = y;
+  else if(x == x->parent->right)
+    x->parent->right = y;
+  else
+    x->parent->left = y;
+  y->right = x;
+  x->parent = y;
+}
+
+static int
+isred(struct rbnode *n)
+{
+  return n != 0 && n->red;
+}
+
+// Hang node off parent at *link, the empty child slot
+// that the caller's search ended on.
+void
+rb_link(struct rbnode *node, struct rbnode *parent, struct rbnode **link)
+{
+  node->parent = parent;
+  node->left = node->right = 0;
+  node->red = 1;
+  *link = node;
+}
+
+// Restore the red-black properties after rb_link().
+void
+rb_insert(struct rbroot *root, struct rbnode *z)
+{
+  struct rbnode *p, *g, *u;
+
+  while((p = z->parent) != 0 && p->red){
+    g = p->parent;    // p is red, so it is not the root.
+    if(p == g->left){
+      u = g->right;
+      if(isred(u)){
+        p->red = u->red = 0;
+        g->red = 1;
+        z = g;
+        continue;
+      }
+      if(z == p->right){
+        rotate_left(root, p);
+        z = p;
+        p = z->parent;
+      }
+      p->red = 0;
+      g->red = 1;
+      rotate_right(root, g);
+    } else {
+      u = g->left;
+      if(isred(u)){
+        p->red = u->red = 0;
+        g->red = 1;
+        z = g;
+        continue;
+      }
+      if(z == p->left){
+        rotate_right(root, p);
+        z = p;
+        p = z->parent;
+      }
+      p->red = 0;
+      g->red = 1;
+      rotate_left(root, g);
+    }
+  }
+  root->node->red = 0;
+}
+
+// Replace the subtree rooted at u with the one rooted at v.
+static void
+transplant(struct rbroot *root, struct rbnode *u, struct rbnode *v)
+{
+  if(u->parent == 0)
+    root->node = v;
+  else if(u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+  if(v)
+    v->parent = u->parent;
+}
+
+// x may be null, so its parent is passed separately.
+static void
+erase_fixup(struct rbroot *root, struct rbnode *x, struct rbnode *xp)
+{
+  struct rbnode *w;
+
+  while(x != root->node && !isred(x)){
+    if(x == xp->left){
+      w = xp->right;
+      if(w->red){
+        w->red = 0;
+        xp->red = 1;
+        rotate_left(root, xp);
+        w = xp->right;
+      }
+      if(!isred(w->left) && !isred(w->right)){
+        w->red = 1;
+        x = xp;
+        xp = x->parent;
+      } else {
+        if(!isred(w->right)){
+          w->left->red = 0;
+          w->red = 1;
+          rotate_right(root, w);
+          w = xp->right;
+        }
+        w->red = xp->red;
+        xp->red = 0;
+        w->right->red = 0;
+        rotate_left(root, xp);
+        x = root->node;
+      }
+    } else {
+      w = xp->left;
+      if(w->red){
+        w->red = 0;
+        xp->red = 1;
+        rotate_right(root, xp);
+        w = xp->left;
+      }
+      if(!isred(w->left) && !isred(w->right)){
+        w->red = 1;
+        x = xp;
+        xp = x->parent;
+      } else {
+        if(!isred(w->left)){
+          w->right->red = 0;
+          w->red = 1;
+          rotate_left(root, w);
+          w = xp->left;
+        }
+        w->red = xp->red;
+        xp->red = 0;
+        w->left->red = 0;
+        rotate_right(root, xp);
+        x = root->node;
+      }
+    }
+  }
+  if(x)
+    x->red = 0;
+}
+
+// Unlink z from the tree.
+void
+rb_erase(struct rbroot *root, struct rbnode *z)
+{
+  struct rbnode *y, *x, *xp;
+  int wasred;
+
+  wasred = z->red;
+  if(z->left == 0){
+    x = z->right;
+    xp = z->parent;
+    transplant(root, z, x);
+  } else if(z->right == 0){
+    x = z->left;
+    xp = z->parent;
+    transplant(root, z, x);
+  } else {
+    // splice out z's successor y and put it in z's place.
+    y = z->right;
+    while(y->left)
+      y = y->left;
+    wasred = y->red;
+    x = y->right;
+    if(y->parent == z){
+      xp = y;
+    } else {
+      xp = y->parent;
+      transplant(root, y, x);
+      y->right = z->right;
+      y->right->parent = y;
+    }
+    transplant(root, z, y);
+    y->left = z->left;
+    y->left->parent = y;
+    y->red = z->red;
+  }
+  if(!wasred)
+    erase_fixup(root, x, xp);
+  z->parent = z->left = z->right = 0;
+}
+
+// Leftmost (smallest) node, or 0 if the tree is empty.
+struct rbnode*
+rb_first(struct rbroot *root)
+{
+  struct rbnode *n = root->node;
+
+  if(n == 0)
+    return 0;
+  while(n->left)
+    n = n->left;
+  return n;
+}
+
+// In-order successor of n, or 0.
+struct rbnode*
+rb_next(struct rbnode *n)
+{
+  struct rbnode *p;
+
+  if(n->right){
+    n = n->right;
+    while(n->left)
+      n = n->left;
+    return n;
+  }
+  while((p = n->parent) != 0 && n == p->right)
+    n = p;
+  return p;
+}
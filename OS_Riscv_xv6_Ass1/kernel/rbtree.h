@@ -0,0 +1,14 @@
+// Intrusive red-black tree.
+// The node is embedded in the object being sorted; the caller
+// walks the tree to find the insertion point (it owns the key),
+// links the node with rb_link(), then rebalances with rb_insert().
+struct rbnode {
+  struct rbnode *parent;
+  struct rbnode *left;
+  struct rbnode *right;
+  int red;
+};
+
+struct rbroot {
+  struct rbnode *node;
+};
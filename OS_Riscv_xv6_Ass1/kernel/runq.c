@@ -0,0 +1,341 @@
+// Per-CPU run queues.
+//
+// A RUNNABLE process waits on exactly one hart's run queue, and
+// each hart schedules from its own queue, so in the common case a
+// RUNNABLE process is only ever inspected by one hart. How a queue
+// orders its processes is up to its scheduling class, a struct
+// sched_class of ops:
+//   policy 0, round robin: sched_rr.c.
+//   policy 1, Task 5 priority: sched_prio.c.
+//   policy 2, Task 6 CFS: sched_cfs.c.
+//   policy 3, earliest deadline first: sched_edf.c.
+// This file keeps the queues and chooses which hart runs what;
+// to add a policy, write its ops and list them in sched_classes[].
+// set_policy() moves the queued processes of every queue from the
+// old class's index to the new one's.
+//
+// Migration: a process that wakes up goes back to the hart it
+// last ran on, to keep its cache warm, unless that queue is
+// RQ_IMBALANCE entries longer than the waker's, in which case it
+// moves to the waker's hart. Preempted processes and new children
+// are queued locally. But a process that would wait behind a busy
+// hart while another is idle goes to the idle one instead, so that
+// forked workers spread out at once. A hart whose queue is empty
+// steals from the longest one.
+//
+// A hart with nothing to run waits in wfi (see idle() in proc.c),
+// unless some queue has a process it could steal. rq_enqueue()
+// sends an IPI to end the wfi when it queues a process on an idle
+// hart, or on a busy one while another hart is idle, so that the
+// idle hart steals it. IDLEPOLL is only a backstop.
+//
+// Lock order: classlock, then p->lock, then rq->lock. p->rq
+// changes only with both p->lock and rq->lock held; the class's
+// links in struct proc are rq->lock's alone.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define RQ_IMBALANCE 2
+
+extern struct sched_class rr_class, prio_class, cfs_class, edf_class;
+
+static struct sched_class *sched_classes[] = {
+[0] &rr_class,
+[1] &prio_class,
+[2] &cfs_class,
+[3] &edf_class,
+};
+
+static struct spinlock classlock;   // serializes set_policy().
+
+// Insert n into t, with ties going right so that
+// they run in FIFO order.
+void
+rqtree_insert(struct rqtree *t, struct rbnode *n, long long (*key)(struct rbnode*))
+{
+  struct rbnode **link = &t->root.node;
+  struct rbnode *parent = 0;
+  long long k = key(n);
+  int leftmost = 1;
+
+  while(*link){
+    parent = *link;
+    if(k < key(parent)){
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      leftmost = 0;
+    }
+  }
+  rb_link(n, parent, link);
+  rb_insert(&t->root, n);
+  if(leftmost)
+    t->leftmost = n;
+}
+
+void
+rqtree_remove(struct rqtree *t, struct rbnode *n)
+{
+  if(t->leftmost == n)
+    t->leftmost = rb_next(n);
+  rb_erase(&t->root, n);
+}
+
+void
+runqinit(void)
+{
+  struct cpu *c;
+
+  initlock(&classlock, "sched_class");
+  edfinit();
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    initlock(&c->rq.lock, "runq");
+    c->rq.class = sched_classes[0];
+    c->rq.head = c->rq.tail = 0;
+    c->rq.acc.root.node = c->rq.acc.leftmost = 0;
+    c->rq.cfs.root.node = c->rq.cfs.leftmost = 0;
+    c->rq.edf.root.node = c->rq.edf.leftmost = 0;
+    c->rq.min_vruntime = 0;
+    c->rq.minacc = ACCMAX;
+    c->rq.nr = 0;
+    c->runacc = ACCMAX;
+  }
+}
+
+// Order every run queue by sched_classes[policy] from now on.
+// Returns -1 if there is no such class.
+int
+set_policy(int policy)
+{
+  struct proc *moved[NPROC];
+  struct sched_class *new, *old;
+  struct runq *rq;
+  struct proc *p;
+  struct cpu *c;
+  int i, n;
+
+  if(policy < 0 || policy >= NELEM(sched_classes))
+    return -1;
+  new = sched_classes[policy];
+
+  acquire(&classlock);
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    rq = &c->rq;
+    acquire(&rq->lock);
+    old = rq->class;
+    if(old != new){
+      // drain in the old class's order, so that
+      // ties in the new one keep it.
+      n = 0;
+      while((p = old->pick_next(rq)) != 0){
+        old->dequeue(rq, p);
+        moved[n++] = p;
+      }
+      rq->class = new;
+      for(i = 0; i < n; i++)
+        new->enqueue(rq, moved[i]);
+    }
+    release(&rq->lock);
+  }
+  release(&classlock);
+  return 0;
+}
+
+// Called by the trap handlers for the running process p after
+// a tick, or when a class has set c->resched. Charges p for the
+// tick by the rules of this hart's class, and returns 1 if p
+// should yield the CPU.
+int
+sched_tick(struct proc *p)
+{
+  struct sched_class *class;
+  struct cpu *c;
+  int preempt = 0;
+
+  acquire(&p->lock);
+  c = mycpu();
+  if(c->ticked){
+    c->ticked = 0;
+    class = c->rq.class;   // a stale class only mischarges one tick.
+    preempt = class->tick(p);
+  }
+  if(c->resched){
+    c->resched = 0;
+    preempt = 1;
+  }
+  release(&p->lock);
+  return preempt;
+}
+
+// Has a class asked to preempt this hart's process?
+int
+resched_pending(void)
+{
+  int r;
+
+  push_off();
+  r = mycpu()->resched;
+  pop_off();
+  return r;
+}
+
+// p, with p->lock held, is about to run on this hart.
+void
+sched_start(struct proc *p)
+{
+  struct cpu *c = mycpu();
+
+  c->ticked = c->resched = 0;
+  if(c->rq.class->start)
+    c->rq.class->start(p);
+}
+
+// Caller must hold p->lock.
+static void
+rq_insert(struct proc *p, struct runq *rq)
+{
+  acquire(&rq->lock);
+  rq->class->enqueue(rq, p);
+  rq->nr++;
+  p->rq = rq;
+  release(&rq->lock);
+}
+
+// An idle hart other than me, or 0 if none is.
+static struct cpu*
+idlecpu(struct cpu *me)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c != me && c->idle)
+      return c;
+  return 0;
+}
+
+// Queue a RUNNABLE process. waking is set when p comes
+// out of sleep(), which lets it return to its last hart.
+// Caller must hold p->lock.
+void
+rq_enqueue(struct proc *p, int waking)
+{
+  struct cpu *c, *me, *last, *idle;
+  int stay;
+
+  if(!holding(&p->lock))
+    panic("rq_enqueue");
+  if(p->rq)
+    return;
+
+  c = me = mycpu();
+  if(waking && p->cpu >= 0){
+    last = &cpus[p->cpu];
+    if(last->idle || last->rq.nr <= me->rq.nr + RQ_IMBALANCE)   // racy, only a hint.
+      c = last;
+  }
+
+  // don't wait behind a busy hart while another is idle. a
+  // process that yields to an empty queue runs again at once.
+  stay = p == me->proc && c == me && c->rq.nr == 0;
+  if(!c->idle && !stay && (idle = idlecpu(me)) != 0)
+    c = idle;
+
+  rq_insert(p, &c->rq);
+
+  // either an idle hart's idle() sees rq.nr, or we see its
+  // c->idle and end its wfi: c's own, or, if p waits behind
+  // a busy hart after all, one that can steal it.
+  __sync_synchronize();
+  if(c != me && c->idle)
+    ipi(c - cpus);
+  else if(!stay && (idle = idlecpu(me)) != 0)
+    ipi(idle - cpus);
+}
+
+// Remove p from its run queue, if it is on one.
+// Caller must hold p->lock.
+void
+rq_dequeue(struct proc *p)
+{
+  struct runq *rq = p->rq;
+
+  if(!holding(&p->lock))
+    panic("rq_dequeue");
+  if(rq == 0)
+    return;
+
+  acquire(&rq->lock);
+  rq->class->dequeue(rq, p);
+  rq->nr--;
+  p->rq = 0;
+  release(&rq->lock);
+}
+
+// Take the class's choice off rq.
+// Returns with its p->lock held, or 0 if there is none.
+static struct proc*
+rq_take(struct runq *rq)
+{
+  struct proc *p;
+
+  // peek under rq->lock, then drop it to respect the lock order.
+  // p may be dequeued in between, so recheck under p->lock.
+  acquire(&rq->lock);
+  p = rq->class->pick_next(rq);
+  release(&rq->lock);
+  if(p == 0)
+    return 0;
+
+  acquire(&p->lock);
+  if(p->state == RUNNABLE && p->rq == rq){
+    rq_dequeue(p);
+    return p;
+  }
+  release(&p->lock);
+  return 0;
+}
+
+// Whether any hart's queue looks non-empty, so
+// that rq_pick() may find something to run or steal.
+int
+rq_any(void)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->rq.nr > 0)
+      return 1;
+  return 0;
+}
+
+// Choose the next process for this hart to run: from its own
+// queue if it can, else stolen from the longest other queue.
+// Returns with p->lock held, p dequeued and still RUNNABLE,
+// or 0 if nothing is runnable.
+struct proc*
+rq_pick(void)
+{
+  struct runq *rq = &mycpu()->rq;
+  struct runq *victim = 0;
+  struct cpu *c;
+  int most = 0;
+
+  if(rq->nr > 0)   // racy peeks; rq_take() rechecks.
+    return rq_take(rq);
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(&c->rq != rq && c->rq.nr > most){
+      most = c->rq.nr;
+      victim = &c->rq;
+    }
+  }
+  if(victim == 0)
+    return 0;
+  return rq_take(victim);
+}
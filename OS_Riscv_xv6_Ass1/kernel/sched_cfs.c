@@ -0,0 +1,68 @@
+// Task 6 CFS scheduling class (policy 2): the process with
+// the smallest vruntime runs next.
+//
+// vruntime is fixed point in hundredths of a tick: every timer
+// tick charges the running process its cfs_priority (75, 100
+// or 125), so low priority processes age faster. Sleeping
+// processes are not charged; when they are queued again their
+// vruntime is raised to the queue's min_vruntime so they cannot
+// monopolize the CPU after a long sleep.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+static struct proc*
+cfsproc(struct rbnode *n)
+{
+  return (struct proc*)((char*)n - (uint64)&((struct proc*)0)->cfsnode);
+}
+
+static long long
+cfskey(struct rbnode *n)
+{
+  return cfsproc(n)->vruntime;
+}
+
+static void
+cfs_enqueue(struct runq *rq, struct proc *p)
+{
+  if(p->vruntime < rq->min_vruntime)
+    p->vruntime = rq->min_vruntime;
+  rqtree_insert(&rq->cfs, &p->cfsnode, cfskey);
+}
+
+static void
+cfs_dequeue(struct runq *rq, struct proc *p)
+{
+  rqtree_remove(&rq->cfs, &p->cfsnode);
+  if(rq->cfs.leftmost == 0 && p->vruntime > rq->min_vruntime)
+    rq->min_vruntime = p->vruntime;
+  else if(rq->cfs.leftmost && cfskey(rq->cfs.leftmost) > rq->min_vruntime)
+    rq->min_vruntime = cfskey(rq->cfs.leftmost);
+}
+
+static struct proc*
+cfs_pick_next(struct runq *rq)
+{
+  return rq->cfs.leftmost ? cfsproc(rq->cfs.leftmost) : 0;
+}
+
+static int
+cfs_tick(struct proc *p)
+{
+  p->vruntime += p->cfs_priority;
+  return 1;
+}
+
+struct sched_class cfs_class = {
+  .name = "cfs",
+  .enqueue = cfs_enqueue,
+  .dequeue = cfs_dequeue,
+  .pick_next = cfs_pick_next,
+  .tick = cfs_tick,
+};
@@ -0,0 +1,224 @@
+// Earliest deadline first scheduling class (policy 3), with
+// constant bandwidth servers.
+//
+// A process reserves runtime every period with set_deadline(),
+// to be done within deadline of each release; admission control
+// keeps the sum of runtime/period over all reservations within
+// EDF_CAPACITY of the harts. Reserved processes run before all
+// others, earliest absolute deadline first; the rest are ordered
+// as in CFS, with cfs_class's ops.
+//
+// The server (CBS, after Abeni and Buttazzo) keeps a reserved
+// process within its bandwidth: its budget is what is left of
+// runtime since the last replenishment, counted from p->rtime.
+// When the budget runs out the deadline is postponed by a period
+// and the budget refilled, so an overrunning process loses
+// priority instead of stealing time from the others. A process
+// that wakes too late to finish its budget by its deadline gets
+// a new deadline and a full budget.
+//
+// dltimer ends the running process's budget, and a newly queued
+// process with an earlier deadline than the running one asks for
+// it to be preempted, through c->resched. A woken process goes to
+// an idle hart if there is one, and rq_enqueue()'s IPI starts it
+// at once; c->resched on a busy hart takes effect only at its next
+// interrupt or system call return, up to a tick later.
+//
+// A job that starts running after its deadline counts once as a
+// miss in p->dl_misses, however often it is dispatched late.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define EDF_CAPACITY 950   // admissible load per hart, in 1/1000
+
+extern struct sched_class cfs_class;
+
+static struct spinlock dl_lock;
+static int dl_total_bw;    // Sum of admitted dl_bw, in 1/1000 of a hart.
+
+static struct proc*
+edfproc(struct rbnode *n)
+{
+  return (struct proc*)((char*)n - (uint64)&((struct proc*)0)->edfnode);
+}
+
+static long long
+edfkey(struct rbnode *n)
+{
+  return edfproc(n)->dl_abs;
+}
+
+static struct cpu*
+rqcpu(struct runq *rq)
+{
+  return (struct cpu*)((char*)rq - (uint64)&((struct cpu*)0)->rq);
+}
+
+// Run time p has used so far, counting the current run.
+static uint64
+used(struct proc *p, uint64 now)
+{
+  return p->rtime + (p->state == RUNNING ? now - p->stamp : 0);
+}
+
+// What is left of p's budget, in mtime cycles.
+static long long
+budget(struct proc *p, uint64 now)
+{
+  return (long long)(p->dl_rtime0 + p->dl_runtime) - (long long)used(p, now);
+}
+
+// Apply the CBS rules before p is queued.
+static void
+dl_update(struct proc *p, uint64 now)
+{
+  long long b;
+
+  // budget exhausted: postpone the deadline and refill.
+  while((b = budget(p, now)) <= 0){
+    p->dl_abs += p->dl_period;
+    p->dl_rtime0 += p->dl_runtime;
+  }
+  // the rest of the budget can't be used by the deadline
+  // at the reserved rate: start a new job.
+  if(p->dl_abs <= now ||
+     (uint64)b * p->dl_period > (p->dl_abs - now) * p->dl_runtime){
+    p->dl_abs = now + p->dl_deadline;
+    p->dl_rtime0 = used(p, now);
+  }
+}
+
+static void dlexpire(struct hrtimer*);
+
+void
+edfinit(void)
+{
+  struct cpu *c;
+
+  initlock(&dl_lock, "dl");
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    hrtimer_init(&c->dltimer, dlexpire);
+}
+
+static void
+edf_enqueue(struct runq *rq, struct proc *p)
+{
+  struct proc *cur;
+
+  if(p->dl_runtime == 0){
+    cfs_class.enqueue(rq, p);
+    return;
+  }
+  dl_update(p, r_time());
+  rqtree_insert(&rq->edf, &p->edfnode, edfkey);
+
+  // preempt the hart's process if p is due first.
+  // cur's reservation is read without its lock, as a hint.
+  cur = rqcpu(rq)->proc;
+  if(cur && (cur->dl_runtime == 0 || p->dl_abs < cur->dl_abs))
+    rqcpu(rq)->resched = 1;
+}
+
+static void
+edf_dequeue(struct runq *rq, struct proc *p)
+{
+  if(p->dl_runtime == 0)
+    cfs_class.dequeue(rq, p);
+  else
+    rqtree_remove(&rq->edf, &p->edfnode);
+}
+
+static struct proc*
+edf_pick_next(struct runq *rq)
+{
+  if(rq->edf.leftmost)
+    return edfproc(rq->edf.leftmost);
+  return cfs_class.pick_next(rq);
+}
+
+static int
+edf_tick(struct proc *p)
+{
+  if(p->dl_runtime == 0)
+    return cfs_class.tick(p);
+  return budget(p, r_time()) <= 0;
+}
+
+// The running process used up its budget.
+static void
+dlexpire(struct hrtimer *t)
+{
+  mycpu()->resched = 1;
+}
+
+static void
+edf_start(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+
+  if(p->dl_runtime == 0){
+    hrtimer_cancel(&c->dltimer);
+    return;
+  }
+  if(now > p->dl_abs && p->dl_missed != p->dl_abs){
+    p->dl_misses++;
+    p->dl_missed = p->dl_abs;
+  }
+  hrtimer_start(&c->dltimer, now + budget(p, now));
+}
+
+struct sched_class edf_class = {
+  .name = "edf",
+  .enqueue = edf_enqueue,
+  .dequeue = edf_dequeue,
+  .pick_next = edf_pick_next,
+  .tick = edf_tick,
+  .start = edf_start,
+};
+
+// Reserve runtime of every period for the calling process,
+// due within deadline of each release, all in mtime cycles.
+// runtime 0 gives up the reservation. Returns -1 if the
+// parameters are inconsistent or the harts are fully booked.
+int
+set_deadline(uint64 runtime, uint64 deadline, uint64 period)
+{
+  struct proc *p = myproc();
+  int bw = 0;
+
+  if(runtime){
+    if(runtime > deadline || deadline > period)
+      return -1;
+    bw = (runtime * 1000 + period - 1) / period;
+    if(bw > EDF_CAPACITY)   // more than one hart can give.
+      return -1;
+  }
+
+  acquire(&p->lock);
+  acquire(&dl_lock);
+  if(dl_total_bw - p->dl_bw + bw > nharts * EDF_CAPACITY){
+    release(&dl_lock);
+    release(&p->lock);
+    return -1;
+  }
+  dl_total_bw += bw - p->dl_bw;
+  release(&dl_lock);
+
+  // p is running, so it is on no queue and
+  // changing its class keys is safe.
+  p->dl_bw = bw;
+  p->dl_runtime = runtime;
+  p->dl_deadline = deadline;
+  p->dl_period = period;
+  p->dl_abs = r_time() + deadline;
+  p->dl_rtime0 = used(p, r_time());
+  release(&p->lock);
+  return 0;
+}
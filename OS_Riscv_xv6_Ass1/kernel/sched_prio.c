@@ -0,0 +1,63 @@
+// Task 5 priority scheduling class (policy 1): the process
+// with the smallest accumulator runs next, and every tick adds
+// the running process's ps_priority to its accumulator.
+//
+// Each queue caches its smallest accumulator, and each hart
+// publishes the accumulator of the process it runs, so that
+// minAccumulator() is a lock-free reduce over NCPU harts.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+static struct proc*
+accproc(struct rbnode *n)
+{
+  return (struct proc*)((char*)n - (uint64)&((struct proc*)0)->accnode);
+}
+
+static long long
+acckey(struct rbnode *n)
+{
+  return accproc(n)->accumulator;
+}
+
+static void
+prio_enqueue(struct runq *rq, struct proc *p)
+{
+  rqtree_insert(&rq->acc, &p->accnode, acckey);
+  rq->minacc = acckey(rq->acc.leftmost);
+}
+
+static void
+prio_dequeue(struct runq *rq, struct proc *p)
+{
+  rqtree_remove(&rq->acc, &p->accnode);
+  rq->minacc = rq->acc.leftmost ? acckey(rq->acc.leftmost) : ACCMAX;
+}
+
+static struct proc*
+prio_pick_next(struct runq *rq)
+{
+  return rq->acc.leftmost ? accproc(rq->acc.leftmost) : 0;
+}
+
+static int
+prio_tick(struct proc *p)
+{
+  p->accumulator += p->ps_priority;
+  mycpu()->runacc = p->accumulator;
+  return 1;
+}
+
+struct sched_class prio_class = {
+  .name = "priority",
+  .enqueue = prio_enqueue,
+  .dequeue = prio_dequeue,
+  .pick_next = prio_pick_next,
+  .tick = prio_tick,
+};
@@ -0,0 +1,55 @@
+// Round robin scheduling class (policy 0): a FIFO list,
+// and every tick preempts.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+static void
+rr_enqueue(struct runq *rq, struct proc *p)
+{
+  p->rqnext = 0;
+  p->rqprev = rq->tail;
+  if(rq->tail)
+    rq->tail->rqnext = p;
+  else
+    rq->head = p;
+  rq->tail = p;
+}
+
+static void
+rr_dequeue(struct runq *rq, struct proc *p)
+{
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    rq->head = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    rq->tail = p->rqprev;
+}
+
+static struct proc*
+rr_pick_next(struct runq *rq)
+{
+  return rq->head;
+}
+
+static int
+rr_tick(struct proc *p)
+{
+  return 1;
+}
+
+struct sched_class rr_class = {
+  .name = "rr",
+  .enqueue = rr_enqueue,
+  .dequeue = rr_dequeue,
+  .pick_next = rr_pick_next,
+  .tick = rr_tick,
+};
@@ -11,9 +11,10 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][4];
 
-// assembly code in kernelvec.S for machine-mode timer interrupt.
+// assembly code in kernelvec.S for machine-mode timer
+// and software interrupts.
 extern void timervec();
 
 // entry.S jumps here in machine mode on stack0.
@@ -59,31 +60,34 @@ start()
 // at timervec in kernelvec.S,
 // which turns them into software interrupts for
 // devintr() in trap.c.
+// the timer is one-shot: hrtimer.c programs mtimecmp
+// from supervisor mode for the next event, if any.
 void
 timerinit()
 {
   // each CPU has a separate source of timer interrupts.
   int id = r_mhartid();
 
-  // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+  // no event until the kernel asks for one.
+  *(uint64*)CLINT_MTIMECMP(id) = ~0ULL;
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
   w_mscratch((uint64)scratch);
 
+  // let supervisor mode read the time CSR, for r_time().
+  w_mcounteren(r_mcounteren() | 2);
+
   // set the machine-mode trap handler.
   w_mtvec((uint64)timervec);
 
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer interrupts, and software
+  // interrupts, which other harts send with ipi().
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
 }
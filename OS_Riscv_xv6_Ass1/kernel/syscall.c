@@ -106,6 +106,11 @@ extern uint64 sys_set_ps_priority(void);
 extern uint64 sys_set_cfs_priority(void);
 extern uint64 sys_get_cfs_stats(void);
 extern uint64 sys_set_policy(void);
+extern uint64 sys_get_sched_latency(void);
+extern uint64 sys_get_wakeup_stats(void);
+extern uint64 sys_usleep(void);
+extern uint64 sys_get_proc_stats(void);
+extern uint64 sys_set_deadline(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -136,6 +141,11 @@ static uint64 (*syscalls[])(void) = {
 [SYS_set_cfs_priority] sys_set_cfs_priority,
 [SYS_get_cfs_stats] sys_get_cfs_stats,
 [SYS_set_policy] sys_set_policy,
+[SYS_get_sched_latency] sys_get_sched_latency,
+[SYS_get_wakeup_stats] sys_get_wakeup_stats,
+[SYS_usleep] sys_usleep,
+[SYS_get_proc_stats] sys_get_proc_stats,
+[SYS_set_deadline] sys_set_deadline,
 };
 
 void
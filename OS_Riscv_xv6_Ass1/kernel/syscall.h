@@ -25,3 +25,8 @@
 #define SYS_set_cfs_priority 24
 #define SYS_get_cfs_stats 25
 #define SYS_set_policy 26
+#define SYS_get_sched_latency 27
+#define SYS_get_wakeup_stats 28
+#define SYS_usleep 29
+#define SYS_get_proc_stats 30
+#define SYS_set_deadline 31
@@ -56,20 +56,24 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  return hrsleep(r_time() + (uint64)n * TICKCYCLES);
+}
+
+// sleep for usec microseconds, to the resolution
+// of the timer rather than of the scheduler tick.
+uint64
+sys_usleep(void)
+{
+  int usec;
+
+  argint(0, &usec);
+  if(usec < 0)
+    usec = 0;
+  return hrsleep(r_time() + (uint64)usec * (TIMEBASE / 1000000));
 }
 
 uint64
@@ -81,17 +85,12 @@ sys_kill(void)
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
-// since start.
+// return how many clock ticks have passed since start.
+// harts do not tick while idle, so count them from mtime.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
-
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  return r_time() / TICKCYCLES;
 }
 
 uint64 // Task 2
@@ -136,9 +135,43 @@ uint64 // Task 7
 sys_set_policy(void){
   int n;
   argint(0, &n);
-  if(n < 0 || n > 2){
+  return set_policy(n);
+}
+
+uint64
+sys_get_sched_latency(void){
+  uint64 hist;
+  argaddr(0, &hist);
+  return get_sched_latency(hist);
+}
+
+uint64
+sys_get_wakeup_stats(void){
+  uint64 st;
+  argaddr(0, &st);
+  return get_wakeup_stats(st);
+}
+
+uint64
+sys_get_proc_stats(void){
+  uint64 ps;
+  int n;
+  argaddr(0, &ps);
+  argint(1, &n);
+  return get_proc_stats(ps, n);
+}
+
+// reserve runtime microseconds of every period microseconds,
+// due deadline microseconds after each release; see sched_edf.c.
+uint64
+sys_set_deadline(void){
+  int runtime, deadline, period;
+  argint(0, &runtime);
+  argint(1, &deadline);
+  argint(2, &period);
+  if(runtime < 0 || deadline < 0 || period < 0)
     return -1;
-  }
-  set_policy(n);
-  return 0;
+  return set_deadline((uint64)runtime * (TIMEBASE / 1000000),
+                      (uint64)deadline * (TIMEBASE / 1000000),
+                      (uint64)period * (TIMEBASE / 1000000));
 }
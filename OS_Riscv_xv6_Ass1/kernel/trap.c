@@ -6,9 +6,6 @@
 #include "proc.h"
 #include "defs.h"
 
-struct spinlock tickslock;
-uint ticks;
-
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -19,14 +16,17 @@ extern int devintr();
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  hrtimerinit();
 }
 
+static void tick(struct hrtimer*);
+
 // set up to take exceptions and traps while in the kernel.
 void
 trapinithart(void)
 {
   w_stvec((uint64)kernelvec);
+  hrtimer_init(&mycpu()->tick, tick);
 }
 
 //
@@ -76,15 +76,10 @@ usertrap(void)
   if(killed(p))
     exit(-1, "");
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2){
-      timerUpdate();
-      acquire(&p->lock);
-        p->accumulator += p->ps_priority; // Task 5
-      release(&p->lock);
-        
-        yield();
-  }
+  // give up the CPU if this is a timer interrupt,
+  // or if the scheduling class asked for it.
+  if((which_dev == 2 || resched_pending()) && sched_tick(p))
+    yield();
 
   usertrapret();
 }
@@ -157,17 +152,8 @@ kerneltrap()
   }
   struct proc *p = myproc();
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2){
-    // this is for Task 6
-    timerUpdate();
-  }
-  if(which_dev == 2 && p != 0 && p->state == RUNNING){
-    // this is for Task 5
-    acquire(&p->lock);
-    p->accumulator += p->ps_priority; // Task 5
-    release(&p->lock);
+  if((which_dev == 2 || resched_pending()) && p != 0 && p->state == RUNNING && sched_tick(p))
     yield();
-  }
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -175,19 +161,58 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// The scheduler tick: devintr() reports it so that the trap
+// handlers charge and preempt the running process. It stops
+// re-arming once the hart has nothing to run, and scheduler()
+// starts it again with tickstart().
+static void
+tick(struct hrtimer *t)
+{
+  struct cpu *c = mycpu();
+  uint64 next = t->expires + TICKCYCLES;
+
+  c->ticked = 1;
+  if(c->proc == 0)
+    return;
+  if(next <= r_time())   // don't replay ticks missed while interrupts were off.
+    next = r_time() + TICKCYCLES;
+  hrtimer_start(t, next);
+}
+
+// Make sure this hart is ticking, before it runs a process.
+// Called with interrupts off.
 void
+tickstart(void)
+{
+  struct cpu *c = mycpu();
+
+  if(!hrtimer_active(&c->tick))
+    hrtimer_start(&c->tick, r_time() + TICKCYCLES);
+}
+
+// Run the timers that are due on this hart.
+// Returns 2 if the scheduler tick was one of them, else 1.
+static int
 clockintr()
 {
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
+  struct cpu *c = mycpu();
+
+  c->ticked = 0;
+  hrtimer_interrupt();
+  return c->ticked ? 2 : 1;
+}
+
+// interrupt hart, to end its wfi in idle().
+void
+ipi(int hart)
+{
+  *(uint32*)CLINT_MSIP(hart) = 1;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if the scheduler tick,
+// 1 if other device or timer,
 // 0 if not recognized.
 int
 devintr()
@@ -217,18 +242,16 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or an IPI, forwarded by timervec in kernelvec.S. an IPI
+    // finds no timer due; it only ends a wfi in idle().
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before the timers run and
+    // program the next one.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return clockintr();
   } else {
     return 0;
   }
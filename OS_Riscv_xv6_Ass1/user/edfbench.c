@@ -0,0 +1,135 @@
+// EDF benchmark: periodic reserved processes run next to a
+// cfs.c-style mixed load under the EDF class; prints how many of
+// their jobs missed a deadline. Also checks that admission
+// control turns away a reservation the harts can't hold.
+//
+// usage: edfbench [nrt [nload]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+#define RUNTIME 2000    // microseconds of every
+#define PERIOD 10000    //   period, due at its end.
+#define JOBS 300
+
+// about a millisecond of work, well within RUNTIME.
+static void
+job(void)
+{
+  for(volatile int i = 0; i < 20000; i++)
+    ;
+}
+
+// like cfs.c: compute, sleeping a tick now and then.
+static void
+load(int prio)
+{
+  set_cfs_priority(prio);
+  for(;;){
+    for(int i = 1; i <= 1000000; i++)
+      if(i % 100000 == 0)
+        sleep(1);
+  }
+}
+
+static void
+periodic(void)
+{
+  if(set_deadline(RUNTIME, PERIOD, PERIOD) < 0){
+    printf("edfbench: set_deadline refused\n");
+    exit(1, "");
+  }
+  for(int i = 0; i < JOBS; i++){
+    job();
+    usleep(PERIOD - RUNTIME);
+  }
+  exit(0, "");
+}
+
+// have n children each ask for half a hart, and hold on to it
+// until all have asked; returns how many were admitted.
+static int
+admit(int n)
+{
+  int res[2], hold[2], i, ok = 0;
+  char c;
+
+  if(pipe(res) < 0 || pipe(hold) < 0)
+    return -1;
+  for(i = 0; i < n; i++){
+    if(fork() == 0){
+      close(hold[1]);
+      c = set_deadline(PERIOD/2, PERIOD, PERIOD) == 0;
+      write(res[1], &c, 1);
+      read(hold[0], &c, 1);
+      exit(0, "");
+    }
+  }
+  for(i = 0; i < n; i++){
+    read(res[0], &c, 1);
+    ok += c;
+  }
+  close(hold[1]);
+  close(hold[0]);
+  close(res[0]);
+  close(res[1]);
+  for(i = 0; i < n; i++)
+    wait(0, 0);
+  return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static struct pstat ps[NPROC];
+  int nrt = 2, nload = 6;
+  int rt[NPROC], ld[NPROC];
+  int i, j, n, status, misses = 0;
+
+  if(argc > 1)
+    nrt = atoi(argv[1]);
+  if(argc > 2)
+    nload = atoi(argv[2]);
+  if(nrt < 1 || nload < 0 || nrt + nload > NPROC - 4){
+    printf("edfbench: bad counts\n");
+    exit(1, "");
+  }
+  if(set_policy(3) < 0){
+    printf("edfbench: no EDF class\n");
+    exit(1, "");
+  }
+
+  printf("admitted %d of %d half-hart reservations\n", admit(2*NCPU), 2*NCPU);
+
+  for(i = 0; i < nload; i++)
+    if((ld[i] = fork()) == 0)
+      load(i % 3);
+  for(i = 0; i < nrt; i++)
+    if((rt[i] = fork()) == 0)
+      periodic();
+
+  // collect the periodic ones' miss counts while they are zombies.
+  for(i = 0; i < nrt; i++){
+    while(1){
+      n = get_proc_stats(ps, NPROC);
+      for(j = 0; j < n; j++)
+        if(ps[j].pid == rt[i] && ps[j].state == 5)   // ZOMBIE
+          break;
+      if(j < n)
+        break;
+      sleep(1);
+    }
+    misses += ps[j].dlmiss;
+  }
+  for(i = 0; i < nload; i++)
+    kill(ld[i]);
+  while(wait(&status, 0) > 0)
+    ;
+
+  printf("%d periodic processes, %d jobs each next to %d loaders: %d missed deadlines (%d per 1000)\n",
+         nrt, JOBS, nload, misses, misses * 1000 / (nrt * JOBS));
+  set_policy(0);
+  exit(0, "");
+}
@@ -4,12 +4,14 @@
 int
 main(int argc, char *argv[])
 {
+    if(argc < 2){
+        printf("usage: policy 0|1|2|3\n");
+        exit(1,"");
+    }
     int policy = atoi(argv[1]);
-    if(policy > 2 || policy < 0) // policy can only be 0,1 or 2. otherwise - incorrect.
-        printf("Error - invalid policy value. please enter 0, 1 or 2.\n");
-    else{
-        set_policy(policy);
+    if(set_policy(policy) < 0) // the kernel knows which policies exist.
+        printf("Error - invalid policy value. please enter 0, 1, 2 or 3.\n");
+    else
         printf("Success on performing set_policy system call !\n");
-    }
     exit(0,"");
 }
\ No newline at end of file
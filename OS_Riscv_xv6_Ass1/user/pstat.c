@@ -0,0 +1,37 @@
+// Print the scheduler statistics of every process:
+// time running, waiting for a hart and sleeping, in
+// milliseconds, voluntary and involuntary context
+// switches, EDF deadline misses, and the hart each last ran on.
+//
+// usage: pstat
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+#define MS(t) ((int)((t) / (TIMEBASE / 1000)))
+
+static char *states[] = {
+  "unused", "used", "sleep", "runble", "run", "zombie"
+};
+
+int
+main(int argc, char *argv[])
+{
+  static struct pstat ps[NPROC];
+  int i, n;
+
+  if((n = get_proc_stats(ps, NPROC)) < 0){
+    printf("pstat: get_proc_stats failed\n");
+    exit(1, "");
+  }
+  printf("pid\tstate\tcpu\trun\tready\tsleep\tvcsw\tivcsw\tmiss\tname\n");
+  for(i = 0; i < n; i++){
+    printf("%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%s\n",
+           ps[i].pid, states[ps[i].state], ps[i].cpu,
+           MS(ps[i].rtime), MS(ps[i].retime), MS(ps[i].stime),
+           ps[i].nvcsw, ps[i].nivcsw, ps[i].dlmiss, ps[i].name);
+  }
+  exit(0, "");
+}
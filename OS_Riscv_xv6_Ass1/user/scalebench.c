@@ -0,0 +1,80 @@
+// Scheduler scalability benchmark: pairs of processes bounce a
+// byte through two pipes, so every round trip costs two context
+// switches. Prints context switches per second; run it after
+// booting with CPUS=1 through CPUS=8 to compare.
+//
+// usage: scalebench [policy [pairs]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define TICKS 50    // measurement length; a tick is 1/10 second.
+
+static void
+pingpong(int rfd, int wfd, int first)
+{
+  char c = 0;
+
+  if(first)
+    write(wfd, &c, 1);
+  for(;;){
+    if(read(rfd, &c, 1) != 1)
+      exit(0, "");
+    write(wfd, &c, 1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint hist[NSCHEDHIST];
+  int policy = 0, pairs = 8;
+  int pids[2*NPROC];
+  int n = 0, i, a[2], b[2], start, elapsed;
+  uint total;
+
+  if(argc > 1)
+    policy = atoi(argv[1]);
+  if(argc > 2)
+    pairs = atoi(argv[2]);
+  if(pairs < 1 || pairs > NPROC/2 - 2)
+    pairs = 8;
+  set_policy(policy);
+
+  for(i = 0; i < pairs; i++){
+    if(pipe(a) < 0 || pipe(b) < 0){
+      printf("scalebench: pipe failed\n");
+      break;
+    }
+    if((pids[n] = fork()) == 0)
+      pingpong(a[0], b[1], 1);
+    n++;
+    if((pids[n] = fork()) == 0)
+      pingpong(b[0], a[1], 0);
+    n++;
+    close(a[0]); close(a[1]);
+    close(b[0]); close(b[1]);
+  }
+
+  sleep(2);   // let everyone get going.
+  get_sched_latency(hist);
+  start = uptime();
+  sleep(TICKS);
+  get_sched_latency(hist);
+  elapsed = uptime() - start;
+
+  for(i = 0; i < n; i++)
+    kill(pids[i]);
+  while(wait(0, 0) > 0)
+    ;
+
+  total = 0;
+  for(i = 0; i < NSCHEDHIST; i++)
+    total += hist[i];
+  if(elapsed < 1)
+    elapsed = 1;
+  printf("policy %d, %d pairs: %d switches in %d ticks, %d switches/sec\n",
+         policy, pairs, total, elapsed, total * 10 / elapsed);
+  exit(0, "");
+}
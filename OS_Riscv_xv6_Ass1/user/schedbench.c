@@ -0,0 +1,146 @@
+// Scheduler benchmark harness: runs the same mix of CPU-bound
+// and I/O-bound children under each scheduling class and prints
+// its throughput, the distribution of scheduling decision latency
+// measured by the kernel, and the tail of the time the children
+// spent runnable but waiting for a hart.
+//
+// usage: schedbench [policy]   (default: every class in turn)
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+#define NCHILD 60
+
+static void
+cpubound(void)
+{
+  volatile int x = 0;
+
+  for(int i = 0; i < 20000000; i++)
+    x += i;
+}
+
+static void
+iobound(void)
+{
+  for(int i = 0; i < 10; i++){
+    for(volatile int j = 0; j < 100000; j++)
+      ;
+    sleep(1);
+  }
+}
+
+// milliseconds this process has spent RUNNABLE.
+static int
+readyms(void)
+{
+  static struct pstat ps[NPROC];
+  int n, pid = getpid();
+
+  n = get_proc_stats(ps, NPROC);
+  for(int i = 0; i < n; i++)
+    if(ps[i].pid == pid)
+      return ps[i].retime / (TIMEBASE / 1000);
+  return 0;
+}
+
+// print the histogram, one power-of-two bucket of
+// timer cycles per line, and the approximate percentiles.
+static void
+report(uint *hist)
+{
+  uint total = 0, seen = 0;
+  int p50 = -1, p99 = -1;
+
+  for(int i = 0; i < NSCHEDHIST; i++)
+    total += hist[i];
+  printf("%d scheduling decisions\n", total);
+  if(total == 0)
+    return;
+  for(int i = 0; i < NSCHEDHIST; i++){
+    seen += hist[i];
+    if(p50 < 0 && seen * 2 >= total)
+      p50 = i;
+    if(p99 < 0 && seen * 100 >= total * 99)
+      p99 = i;
+    if(hist[i])
+      printf("  < %d cycles: %d\n", 1 << (i+1), hist[i]);
+  }
+  printf("p50 < %d cycles, p99 < %d cycles\n", 1 << (p50+1), 1 << (p99+1));
+}
+
+static void
+sort(int *a, int n)
+{
+  for(int i = 1; i < n; i++){
+    int v = a[i], j;
+    for(j = i; j > 0 && a[j-1] > v; j--)
+      a[j] = a[j-1];
+    a[j] = v;
+  }
+}
+
+// run the workload under policy; returns -1 if there is no such class.
+static int
+run(int policy)
+{
+  uint hist[NSCHEDHIST];
+  int ready[NCHILD];
+  int start, elapsed, i, n;
+
+  if(set_policy(policy) < 0)
+    return -1;
+  get_sched_latency(hist);  // discard what came before us.
+
+  start = uptime();
+  for(i = 0; i < NCHILD; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("schedbench: fork failed\n");
+      break;
+    }
+    if(pid == 0){
+      set_cfs_priority(i % 3);
+      if(i % 2)
+        iobound();
+      else
+        cpubound();
+      exit(readyms(), "");
+    }
+  }
+  n = 0;
+  while(wait(&ready[n], 0) > 0)
+    n++;
+  elapsed = uptime() - start;
+  if(elapsed < 1)
+    elapsed = 1;
+
+  get_sched_latency(hist);
+  printf("policy %d: %d children in %d ticks, %d children/sec\n",
+         policy, n, elapsed, n * 10 / elapsed);
+  report(hist);
+  if(n > 0){
+    sort(ready, n);
+    printf("time runnable: p50 %d ms, p99 %d ms, max %d ms\n",
+           ready[n/2], ready[(n*99)/100], ready[n-1]);
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int policy;
+
+  if(argc > 1){
+    if(run(atoi(argv[1])) < 0)
+      printf("schedbench: no policy %s\n", argv[1]);
+    exit(0, "");
+  }
+  for(policy = 0; run(policy) == 0; policy++)
+    printf("\n");
+  set_policy(0);
+  exit(0, "");
+}
@@ -0,0 +1,58 @@
+// Timer benchmark. Checks that usleep() is finer than the
+// scheduler tick, and counts the wakeup() calls made while a
+// crowd of processes sleeps, which used to be one per tick
+// waking every sleeper.
+//
+// usage: sleepbench [usec [sleepers]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define NSLEEP 100
+
+int
+main(int argc, char *argv[])
+{
+  int usec = 1000, sleepers = 30;
+  int pids[NPROC];
+  uint st[2];
+  int i, n, start, elapsed;
+
+  if(argc > 1)
+    usec = atoi(argv[1]);
+  if(argc > 2)
+    sleepers = atoi(argv[2]);
+  if(sleepers < 0 || sleepers > NPROC - 4)
+    sleepers = NPROC - 4;
+
+  // NSLEEP short sleeps: a tick-granular sleep
+  // would take at least NSLEEP ticks.
+  start = uptime();
+  for(i = 0; i < NSLEEP; i++)
+    usleep(usec);
+  elapsed = uptime() - start;
+  printf("%d x usleep(%d) took %d ticks, expected about %d\n",
+         NSLEEP, usec, elapsed, NSLEEP * usec / 100000);
+
+  for(n = 0; n < sleepers; n++){
+    if((pids[n] = fork()) < 0)
+      break;
+    if(pids[n] == 0){
+      sleep(1000);
+      exit(0, "");
+    }
+  }
+  sleep(1);   // let them all get to sleep.
+  get_wakeup_stats(st);
+  sleep(20);
+  get_wakeup_stats(st);
+  printf("%d sleepers over 20 ticks: %d wakeups, %d lock acquisitions\n",
+         n, st[0], st[1]);
+
+  for(i = 0; i < n; i++)
+    kill(pids[i]);
+  while(wait(0, 0) > 0)
+    ;
+  exit(0, "");
+}
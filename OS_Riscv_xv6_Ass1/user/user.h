@@ -1,4 +1,5 @@
 struct stat;
+struct pstat;
 
 // system calls
 int fork(void);
@@ -26,7 +27,12 @@ int memsize(void);              // Task 2
 void set_ps_priority(int);      // Task 5
 void set_cfs_priority(int);     // Task 6
 void get_cfs_stats(int, int*);  // Task 6
-void set_policy(int);           // Task 7
+int set_policy(int);            // Task 7
+int get_sched_latency(uint*);
+int get_wakeup_stats(uint*);
+int usleep(int);
+int get_proc_stats(struct pstat*, int);
+int set_deadline(int, int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -41,3 +41,8 @@ entry("set_ps_priority");
 entry("set_cfs_priority");
 entry("get_cfs_stats");
 entry("set_policy");
+entry("get_sched_latency");
+entry("get_wakeup_stats");
+entry("usleep");
+entry("get_proc_stats");
+entry("set_deadline");
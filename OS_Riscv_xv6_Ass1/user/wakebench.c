@@ -0,0 +1,47 @@
+// Counts the locks wakeup() acquires while a parent and child
+// bounce a byte through two pipes, with every other process
+// slot either sleeping or free.
+//
+// usage: wakebench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  uint st[2];
+  int rounds = 1000;
+  int a[2], b[2], i;
+  char c = 0;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf("wakebench: pipe failed\n");
+    exit(1, "");
+  }
+  if(fork() == 0){
+    while(read(a[0], &c, 1) == 1)
+      write(b[1], &c, 1);
+    exit(0, "");
+  }
+  close(a[0]);
+  close(b[1]);
+
+  get_wakeup_stats(st);
+  for(i = 0; i < rounds; i++){
+    write(a[1], &c, 1);
+    read(b[0], &c, 1);
+  }
+  get_wakeup_stats(st);
+  close(a[1]);
+  wait(0, 0);
+
+  printf("%d round trips: %d wakeups, %d lock acquisitions\n", rounds, st[0], st[1]);
+  if(st[0])
+    printf("%d locks per wakeup; a full-table min scan plus wake scan took %d\n",
+           st[1] / st[0], 2 * (NPROC-1));
+  exit(0, "");
+}
@@ -1,10 +1,16 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
+// Each hash bucket has its own lock, so lookups of different
+// blocks and brelse() proceed in parallel. A miss recycles an
+// unused buffer chosen by the clock algorithm; misses are
+// serialized by bcache.lock, which is taken before any
+// bucket lock.
+//
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
 // * After changing buffer data, call bwrite to write it to disk.
@@ -12,6 +18,10 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+// * To start reading blocks that will be wanted soon,
+//     call bprefetch; it does not wait for the disk.
+// * To write a buffer later instead of now, call bdirty;
+//     bflush writes all dirty buffers.
 
 
 #include "types.h"
@@ -19,73 +29,200 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
+#include "memlayout.h"
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
 
-struct {
+#define NBUCKET 61
+#define BHASH(dev, blockno) (((dev) * 31 + (blockno)) % NBUCKET)
+
+extern char end[]; // first address after kernel.
+
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;       // Chain through b->hnext.
+};
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+struct {
+  struct spinlock lock;   // Serializes misses.
+  int nbuf;
+  struct sleeplock flushlock; // One bflush() at a time.
+  int nflushing;          // Buffers bflush() has in flight.
+
+  struct buf *hand;       // Clock hand, in the ring through b->cnext.
+  struct bucket bucket[NBUCKET];
+
+  uint64 nhit;            // Statistics, updated atomically.
+  uint64 nmiss;
+  uint64 cycles;          // mtime cycles spent in bget().
 } bcache;
 
+// Size the cache at BUFPCT percent of the memory
+// after the kernel, at least NBUF buffers and no
+// more than the disk has blocks.
 void
 binit(void)
 {
-  struct buf *b;
+  struct buf *b, *last = 0;
+  char *pg = 0;
+  int n, i, j = 0;
 
   initlock(&bcache.lock, "bcache");
+  initsleeplock(&bcache.flushlock, "bflush");
+  for(i = 0; i < NBUCKET; i++)
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+  n = (PHYSTOP - (uint64)end) / 100 * BUFPCT / sizeof(struct buf);
+  if(n > FSSIZE)
+    n = FSSIZE;
+  if(n < NBUF)
+    n = NBUF;
+
+  // Create the clock ring of buffers, several to a page.
+  for(i = 0; i < n; i++){
+    if(pg == 0 || j == PGSIZE / sizeof(struct buf)){
+      if((pg = kalloc()) == 0)
+        break;
+      j = 0;
+    }
+    b = (struct buf*)pg + j++;
+    memset(b, 0, sizeof(*b));
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    if(last)
+      last->cnext = b;
+    else
+      bcache.hand = b;
+    last = b;
+  }
+  if(i < NBUF)
+    panic("binit");
+  last->cnext = bcache.hand;
+  bcache.nbuf = i;
+}
+
+// Return b for block blockno if bk holds it,
+// with a new reference; else 0.
+// Caller must hold bk->lock.
+static struct buf*
+bfind(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b; b = b->hnext){
+    if(b->dev == dev && b->blockno == blockno){
+      b->refcnt++;
+      b->used = 1;
+      return b;
+    }
   }
+  return 0;
+}
+
+// Choose an unused buffer with the clock algorithm,
+// giving recently used ones a second chance, and
+// take it out of its hash chain. Return 0 if every
+// buffer is in use.
+// Caller must hold bcache.lock.
+static struct buf*
+bvictim(void)
+{
+  struct bucket *bk;
+  struct buf *b, **pp;
+  int i;
+
+  for(i = 0; i < 2 * bcache.nbuf; i++){
+    b = bcache.hand;
+    bcache.hand = b->cnext;
+    if(!b->hashed)
+      return b;
+    // b's block changes only under bcache.lock.
+    bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+    acquire(&bk->lock);
+    if(b->refcnt == 0){
+      if(b->used){
+        b->used = 0;
+      } else {
+        for(pp = &bk->head; *pp != b; pp = &(*pp)->hnext)
+          ;
+        *pp = b->hnext;
+        b->hashed = 0;
+        release(&bk->lock);
+        return b;
+      }
+    }
+    release(&bk->lock);
+  }
+  return 0;
 }
 
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
+// For a prefetch, return 0 instead if the block is
+// already cached or every buffer is in use.
 static struct buf*
-bget(uint dev, uint blockno)
+bget(uint dev, uint blockno, int prefetch)
 {
+  struct bucket *bk = &bcache.bucket[BHASH(dev, blockno)];
   struct buf *b;
+  uint64 t0;
 
-  acquire(&bcache.lock);
+  t0 = r_time();
+  acquire(&bk->lock);
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  if((b = bfind(bk, dev, blockno)) != 0){
+    release(&bk->lock);
+    goto hit;
   }
+  release(&bk->lock);
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
+  // Not cached. Once we hold bcache.lock no one else
+  // can add the block, but someone may have already.
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b){
+    release(&bcache.lock);
+    goto hit;
+  }
+
+  // Recycle an unused buffer.
+  if((b = bvictim()) == 0){
+    if(prefetch){
       release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+      return 0;
     }
+    panic("bget: no buffers");
+  }
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  b->used = 1;
+  acquire(&bk->lock);
+  b->hnext = bk->head;
+  bk->head = b;
+  b->hashed = 1;
+  release(&bk->lock);
+  release(&bcache.lock);
+
+  __sync_fetch_and_add(&bcache.nmiss, 1);
+  __sync_fetch_and_add(&bcache.cycles, r_time() - t0);
+  acquiresleep(&b->lock);
+  return b;
+
+hit:
+  if(prefetch){
+    bunpin(b);
+    return 0;
   }
-  panic("bget: no buffers");
+  __sync_fetch_and_add(&bcache.nhit, 1);
+  __sync_fetch_and_add(&bcache.cycles, r_time() - t0);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -94,7 +231,7 @@ bread(uint dev, uint blockno)
 {
   struct buf *b;
 
-  b = bget(dev, blockno);
+  b = bget(dev, blockno, 0);
   if(!b->valid) {
     virtio_disk_rw(b, 0);
     b->valid = 1;
@@ -102,6 +239,63 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Drop a reference to b and unlock it.
+static void
+bput(struct buf *b)
+{
+  struct bucket *bk;
+
+  releasesleep(&b->lock);
+
+  bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+  acquire(&bk->lock);
+  b->refcnt--;
+  release(&bk->lock);
+}
+
+// An asynchronous read has finished. b is still locked
+// by whoever called bprefetch(), who has moved on, so
+// release it here; bread() of the block sleeps on the
+// buffer's lock until then.
+static void
+bprefetched(struct buf *b)
+{
+  b->valid = 1;
+  bput(b);
+}
+
+// Start reading block blockno into the cache, unless it
+// is there already, and return without waiting. This is
+// only a hint: it does nothing if the cache is full.
+void
+bprefetch(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  if((b = bget(dev, blockno, 1)) == 0)
+    return;
+  // bget() hashed the fresh buffer before locking it, so
+  // bread() or bclaim() may have filled it first; a read
+  // now could overwrite what they logged.
+  if(b->valid){
+    bput(b);
+    return;
+  }
+  virtio_disk_submit(b, 0, bprefetched);
+}
+
+// Return a locked buf for block blockno without reading
+// it from disk; the caller overwrites all of it.
+struct buf*
+bclaim(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno, 0);
+  b->valid = 1;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -111,43 +305,160 @@ bwrite(struct buf *b)
   virtio_disk_rw(b, 1);
 }
 
-// Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Mark locked buffer b as newer than its disk block. It
+// stays pinned in the cache until bflush() writes it.
 void
-brelse(struct buf *b)
+bdirty(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
-    panic("brelse");
+    panic("bdirty");
+  if(!b->dirty){
+    b->dirty = 1;
+    bpin(b);
+  }
+}
 
-  releasesleep(&b->lock);
+// bflush()'s write of b has finished. Unlock b, which
+// bflush() locked, and drop bdirty()'s pin in its place.
+static void
+bwritten(struct buf *b)
+{
+  b->dirty = 0;
+  bput(b);
 
   acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+  if(--bcache.nflushing == 0)
+    wakeup(&bcache.nflushing);
+  release(&bcache.lock);
+}
+
+// Write every dirty buffer of dev to disk, and wait for
+// the writes. Runs of up to MAXRUN adjacent blocks go to
+// the disk as one request, and all the requests are in
+// flight at once.
+void
+bflush(uint dev)
+{
+  struct buf *b, *list, *last, **pp;
+  int i, n;
+
+  acquiresleep(&bcache.flushlock);
+
+  // Sort the dirty buffers by block number into a list
+  // through b->rnext. Only bflush() cleans a buffer, and
+  // dirty ones are pinned, so the list stays valid.
+  list = 0;
+  acquire(&bcache.lock);
+  b = bcache.hand;
+  for(i = 0; i < bcache.nbuf; i++, b = b->cnext){
+    if(!b->dirty || b->dev != dev)
+      continue;
+    for(pp = &list; *pp && (*pp)->blockno < b->blockno; pp = &(*pp)->rnext)
+      ;
+    b->rnext = *pp;
+    *pp = b;
+  }
+  release(&bcache.lock);
+
+  while((b = list) != 0){
+    list = b->rnext;
+    b->rnext = 0;
+    // The writes already started unlock their buffers
+    // when they finish, so waiting here cannot deadlock.
+    acquiresleep(&b->lock);
+    // Extend the run with the buffers after b that are
+    // free right now.
+    last = b;
+    n = 1;
+    while(list && n < MAXRUN && list->blockno == last->blockno + 1 &&
+          tryacquiresleep(&list->lock)){
+      last->rnext = list;
+      last = list;
+      list = list->rnext;
+      last->rnext = 0;
+      n++;
+    }
+    acquire(&bcache.lock);
+    bcache.nflushing += n;
+    release(&bcache.lock);
+    virtio_disk_submit(b, 1, bwritten);
   }
-  
+
+  acquire(&bcache.lock);
+  while(bcache.nflushing > 0)
+    sleep(&bcache.nflushing, &bcache.lock);
   release(&bcache.lock);
+
+  releasesleep(&bcache.flushlock);
+}
+
+// Release a locked buffer.
+// Only b's bucket is locked; the clock reads b->used
+// when it comes around.
+void
+brelse(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("brelse");
+
+  bput(b);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+
+  acquire(&bk->lock);
   b->refcnt--;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
+// Fill st[0..3] with cache hits, misses, mtime cycles
+// spent in bget(), and the number of buffers.
+void
+bstat(uint64 *st)
+{
+  st[0] = bcache.nhit;
+  st[1] = bcache.nmiss;
+  st[2] = bcache.cycles;
+  st[3] = bcache.nbuf;
+}
 
+// Forget every cached block of dev that no one is
+// using, so that the next reads of them go to disk.
+// Unused buffers are clean: the log keeps the blocks
+// it has yet to install pinned.
+void
+bdrop(uint dev)
+{
+  struct bucket *bk;
+  struct buf *b, **pp;
+  int i;
+
+  acquire(&bcache.lock);
+  b = bcache.hand;
+  for(i = 0; i < bcache.nbuf; i++, b = b->cnext){
+    if(!b->hashed || b->dev != dev)
+      continue;
+    bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+    acquire(&bk->lock);
+    if(b->refcnt == 0){
+      for(pp = &bk->head; *pp != b; pp = &(*pp)->hnext)
+        ;
+      *pp = b->hnext;
+      b->hashed = 0;
+      b->valid = 0;
+    }
+    release(&bk->lock);
+  }
+  release(&bcache.lock);
+}
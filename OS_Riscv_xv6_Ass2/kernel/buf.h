@@ -1,12 +1,19 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  int dirty;   // newer than the disk; see bdirty()
   uint dev;
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
+  int hashed;       // is it in a bcache hash chain?
+  int used;         // referenced since the clock hand passed?
+  struct buf *hnext; // hash chain
+  struct buf *cnext; // clock ring
+  int qwrite;        // virtio_disk_submit() arguments
+  void (*done)(struct buf *);
+  struct buf *qnext; // disk request queue
+  struct buf *rnext; // next block in the same disk request
   uchar data[BSIZE];
 };
 
@@ -5,6 +5,7 @@ struct inode;
 struct pipe;
 struct proc;
 struct spinlock;
+struct waitq;
 struct sleeplock;
 struct stat;
 struct superblock;
@@ -13,10 +14,16 @@ struct kthread;
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bclaim(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+void            bstat(uint64*);
+void            bprefetch(uint, uint);
+void            bdirty(struct buf*);
+void            bflush(uint);
+void            bdrop(uint);
 
 // console.c
 void            consoleinit(void);
@@ -39,6 +46,8 @@ int             filewrite(struct file*, uint64, int n);
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dirunlink(struct inode*, char*, uint);
+void            dcpurge(uint, uint);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
@@ -51,6 +60,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+void            ireadahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
@@ -64,12 +74,15 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+int             kfreepages(void);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+void            log_sync(void);
+void            log_stat(uint64*);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
@@ -87,11 +100,13 @@ int             cpuid(void);
 void            exit(int);
 int             fork(void);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
+void            kproc(char*, void (*)(void));
 pagetable_t     proc_pagetable(struct proc *);
+int             proc_maptf(struct proc *, pagetable_t);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
 int             killed(struct proc*);
+int             ktkilled(void);
 void            setkilled(struct proc*);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
@@ -100,9 +115,20 @@ void            procinit(void);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            sleep(void*, struct spinlock*);
+int             sleepintr(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeup_one(void*);
+void            waitqinit(void);
+void            futexinit(void);
+void            runqinit(void);
+void            setrunnable(struct kthread*);
+void            schedstat(uint64*);
+void            tlbshootdown(pagetable_t, int);
+void            tlbstat(uint64*);
+int             futex_wait(uint64, int);
+int             futex_wake(uint64, int);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
@@ -112,10 +138,13 @@ int             kthread_create( uint64 start_func, uint64 stack, uint stack_size
 int             kthread_id(void);
 void            kthread_exit(int status);
 int             kthread_kill(int ktid);
+int             kthread_setaffinity(int ktid, int mask);
+int             kthread_gang(int on);
 int             kthread_join(int ktid, uint64 status);
+void            kthread_reapothers(void);
 
 // kthread.c
-void                kthreadinit(struct proc *);
+void                kthreadinit(void);
 struct kthread*     mykthread();
 struct trapframe*   get_kthread_trapframe(struct proc *p, struct kthread *kt);
 int                 allockid(struct proc *p);
@@ -136,6 +165,7 @@ void            pop_off(void);
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+int             tryacquiresleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
@@ -162,6 +192,7 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            ipi(int);
 
 // uart.c
 void            uartinit(void);
@@ -198,7 +229,9 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_submit(struct buf *, int, void (*)(struct buf *));
 void            virtio_disk_intr(void);
+void            virtio_disk_stat(uint64*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "fs.h"
 #include "elf.h"
 
 static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
@@ -66,6 +67,8 @@ exec(char *path, char **argv)
     if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
       goto bad;
     sz = sz1;
+    // the whole segment is about to be read in order.
+    ireadahead(ip, ph.off / BSIZE, (ph.off + ph.filesz + BSIZE - 1) / BSIZE);
     if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
       goto bad;
   }
@@ -122,6 +125,12 @@ exec(char *path, char **argv)
       last = s+1;
   safestrcpy(p->name, last, sizeof(p->name));
     
+  // The other kthreads go. One may have added a
+  // trapframe page since proc_pagetable().
+  kthread_reapothers();
+  if(proc_maptf(p, pagetable) < 0)
+    goto bad;
+
   // Commit to the user image.
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
@@ -130,16 +139,6 @@ exec(char *path, char **argv)
   kt->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
 
-  struct kthread *my_kt = mykthread();
-  
-  for(struct kthread *kt1 = p->kthread; kt1 <&p->kthread[NKT];kt1++){
-    if(kt1 != my_kt){
-      int status = 1;
-      //kthread_kill(kt->tid);
-      kthread_join(kt1->tid, (uint64)&status);
-    }
-  }
-
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
  bad:
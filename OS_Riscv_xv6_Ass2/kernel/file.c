@@ -119,8 +119,30 @@ fileread(struct file *f, uint64 addr, int n)
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
     ilock(f->ip);
+    // a read that starts where the last one ended doubles
+    // the read-ahead window; any other read closes it.
+    if(f->off == f->raoff){
+      f->rawin = f->rawin ? f->rawin * 2 : 4;
+      if(f->rawin > MAXREADAHEAD)
+        f->rawin = MAXREADAHEAD;
+    } else {
+      f->rawin = 0;
+      f->rablock = 0;
+    }
     if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
       f->off += r;
+    f->raoff = f->off;
+    // keep the window's worth of blocks past the new
+    // offset in flight, starting only the ones not yet
+    // asked for.
+    if(f->rawin){
+      if(f->rablock < f->off / BSIZE + 1)
+        f->rablock = f->off / BSIZE + 1;
+      if(f->rablock < f->off / BSIZE + 1 + f->rawin){
+        ireadahead(f->ip, f->rablock, f->off / BSIZE + 1 + f->rawin);
+        f->rablock = f->off / BSIZE + 1 + f->rawin;
+      }
+    }
     iunlock(f->ip);
   } else {
     panic("fileread");
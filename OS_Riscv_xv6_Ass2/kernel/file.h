@@ -6,6 +6,9 @@ struct file {
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
+  uint raoff;        // FD_INODE: where the last read() ended
+  uint rawin;        // FD_INODE: read-ahead window, in blocks
+  uint rablock;      // FD_INODE: first block not yet read ahead
   short major;       // FD_DEVICE
 };
 
@@ -13,6 +16,8 @@ struct file {
 #define minor(dev)  ((dev) & 0xFFFF)
 #define	mkdev(m,n)  ((uint)((m)<<16| (n)))
 
+#define NBMAP 64  // bmap() cache entries per in-memory inode
+
 // in-memory copy of an inode
 struct inode {
   uint dev;           // Device number
@@ -26,7 +31,9 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint addrs[NDIRECT+2];
+  uint bmapbn[NBMAP];   // bmap() cache: 1 + file block number,
+  uint bmapaddr[NBMAP]; // and its disk block; see bmap().
 };
 
 // map major device number to device functions.
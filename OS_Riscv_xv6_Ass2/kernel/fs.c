@@ -178,12 +178,31 @@ struct {
   struct inode inode[NINODE];
 } itable;
 
+// Dentry cache: a direct-mapped table of recent lookups,
+// keyed by (dev, directory inum, name), so that namex() need
+// not read a directory to find a hot name. Entries change
+// only with their directory locked; dirlookup() adds them,
+// dirunlink() and iput() of the directory remove them.
+struct dentry {
+  uint dev;
+  uint dinum;      // directory's inum; 0 if unused
+  char name[DIRSIZ];
+  uint inum;
+  uint off;        // byte offset of the dirent
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry d[NDENTRY];
+} dcache;
+
 void
 iinit()
 {
   int i = 0;
   
   initlock(&itable.lock, "itable");
+  initlock(&dcache.lock, "dcache");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
@@ -309,6 +328,7 @@ ilock(struct inode *ip)
     ip->nlink = dip->nlink;
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    memset(ip->bmapbn, 0, sizeof(ip->bmapbn));
     brelse(bp);
     ip->valid = 1;
     if(ip->type == 0)
@@ -347,6 +367,8 @@ iput(struct inode *ip)
 
     release(&itable.lock);
 
+    if(ip->type == T_DIR)
+      dcpurge(ip->dev, ip->inum);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
@@ -374,27 +396,37 @@ iunlockput(struct inode *ip)
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// listed in block ip->addrs[NDIRECT]. The last NDINDIRECT
+// are listed in the NINDIRECT blocks that block
+// ip->addrs[NDIRECT+1] lists.
 
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
-// returns 0 if out of disk space.
+// Return entry i of indirect block addr, allocating a
+// block for it if necessary; 0 if out of disk space.
 static uint
-bmap(struct inode *ip, uint bn)
+bslot(struct inode *ip, uint addr, uint i)
 {
-  uint addr, *a;
+  uint *a;
   struct buf *bp;
 
-  if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0){
-      addr = balloc(ip->dev);
-      if(addr == 0)
-        return 0;
-      ip->addrs[bn] = addr;
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  if((addr = a[i]) == 0){
+    addr = balloc(ip->dev);
+    if(addr){
+      a[i] = addr;
+      log_write(bp);
     }
-    return addr;
   }
-  bn -= NDIRECT;
+  brelse(bp);
+  return addr;
+}
+
+// Look up block bn past the direct ones through ip's
+// indirect blocks, allocating if necessary.
+static uint
+bmapind(struct inode *ip, uint bn)
+{
+  uint addr;
 
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
@@ -404,30 +436,66 @@ bmap(struct inode *ip, uint bn)
         return 0;
       ip->addrs[NDIRECT] = addr;
     }
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
+    return bslot(ip, addr, bn);
+  }
+  bn -= NINDIRECT;
+
+  if(bn < NDINDIRECT){
+    // Load double-indirect block, then the indirect
+    // block it lists, allocating if necessary.
+    if((addr = ip->addrs[NDIRECT+1]) == 0){
       addr = balloc(ip->dev);
-      if(addr){
-        a[bn] = addr;
-        log_write(bp);
-      }
+      if(addr == 0)
+        return 0;
+      ip->addrs[NDIRECT+1] = addr;
     }
-    brelse(bp);
-    return addr;
+    if((addr = bslot(ip, addr, bn / NINDIRECT)) == 0)
+      return 0;
+    return bslot(ip, addr, bn % NINDIRECT);
   }
 
   panic("bmap: out of range");
 }
 
+// Return the disk block address of the nth block in inode ip.
+// If there is no such block, bmap allocates one.
+// returns 0 if out of disk space.
+// Blocks past the direct ones are remembered in a small
+// direct-mapped cache in the inode, since readi() and
+// read-ahead look up each block more than once.
+static uint
+bmap(struct inode *ip, uint bn)
+{
+  uint addr, c;
+
+  if(bn < NDIRECT){
+    if((addr = ip->addrs[bn]) == 0){
+      addr = balloc(ip->dev);
+      if(addr == 0)
+        return 0;
+      ip->addrs[bn] = addr;
+    }
+    return addr;
+  }
+
+  c = bn % NBMAP;
+  if(ip->bmapbn[c] == bn + 1)
+    return ip->bmapaddr[c];
+  if((addr = bmapind(ip, bn - NDIRECT)) != 0){
+    ip->bmapbn[c] = bn + 1;
+    ip->bmapaddr[c] = addr;
+  }
+  return addr;
+}
+
 // Truncate inode (discard contents).
 // Caller must hold ip->lock.
 void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i, j, k;
+  struct buf *bp, *bp2;
+  uint *a, *a2;
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
@@ -448,6 +516,27 @@ itrunc(struct inode *ip)
     ip->addrs[NDIRECT] = 0;
   }
 
+  if(ip->addrs[NDIRECT+1]){
+    bp = bread(ip->dev, ip->addrs[NDIRECT+1]);
+    a = (uint*)bp->data;
+    for(j = 0; j < NINDIRECT; j++){
+      if(a[j] == 0)
+        continue;
+      bp2 = bread(ip->dev, a[j]);
+      a2 = (uint*)bp2->data;
+      for(k = 0; k < NINDIRECT; k++){
+        if(a2[k])
+          bfree(ip->dev, a2[k]);
+      }
+      brelse(bp2);
+      bfree(ip->dev, a[j]);
+    }
+    brelse(bp);
+    bfree(ip->dev, ip->addrs[NDIRECT+1]);
+    ip->addrs[NDIRECT+1] = 0;
+  }
+  memset(ip->bmapbn, 0, sizeof(ip->bmapbn));
+
   ip->size = 0;
   iupdate(ip);
 }
@@ -471,7 +560,7 @@ stati(struct inode *ip, struct stat *st)
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, bn;
   struct buf *bp;
 
   if(off > ip->size || off + n < off)
@@ -479,6 +568,16 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   if(off + n > ip->size)
     n = ip->size - off;
 
+  // Start reading the rest of the blocks at once, so that
+  // the disk works on them while we wait for the first.
+  for(bn = off/BSIZE + 1; n > 0 && bn <= (off + n - 1)/BSIZE &&
+      bn <= off/BSIZE + MAXBATCH; bn++){
+    uint addr = bmap(ip, bn);
+    if(addr == 0)
+      break;
+    bprefetch(ip->dev, addr);
+  }
+
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
     uint addr = bmap(ip, off/BSIZE);
     if(addr == 0)
@@ -495,6 +594,23 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Start reading blocks [from, to) of ip into the buffer
+// cache without waiting, stopping at the end of the file.
+// Caller must hold ip->lock.
+void
+ireadahead(struct inode *ip, uint from, uint to)
+{
+  uint bn, addr;
+
+  if(to > (ip->size + BSIZE - 1) / BSIZE)
+    to = (ip->size + BSIZE - 1) / BSIZE;
+  for(bn = from; bn < to; bn++){
+    if((addr = bmap(ip, bn)) == 0)
+      break;
+    bprefetch(ip->dev, addr);
+  }
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -546,16 +662,119 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
-// Look for a directory entry in a directory.
-// If found, set *poff to byte offset of entry.
-struct inode*
-dirlookup(struct inode *dp, char *name, uint *poff)
+// FNV-1a hash of a path element.
+static uint
+namehash(const char *name)
 {
-  uint off, inum;
-  struct dirent de;
+  uint h = 2166136261;
+  int i;
 
-  if(dp->type != T_DIR)
-    panic("dirlookup not DIR");
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+static struct dentry*
+dslot(uint dev, uint dinum, char *name)
+{
+  return &dcache.d[(namehash(name) ^ dinum*2654435761U ^ dev) % NDENTRY];
+}
+
+// Return 1 and set *inum and *off if dp's entry
+// for name is cached.
+static int
+dcget(struct inode *dp, char *name, uint *inum, uint *off)
+{
+  struct dentry *d;
+  int hit = 0;
+
+  acquire(&dcache.lock);
+  d = dslot(dp->dev, dp->inum, name);
+  if(d->dinum == dp->inum && d->dev == dp->dev && namecmp(d->name, name) == 0){
+    *inum = d->inum;
+    *off = d->off;
+    hit = 1;
+  }
+  release(&dcache.lock);
+  return hit;
+}
+
+static void
+dcput(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  d = dslot(dp->dev, dp->inum, name);
+  d->dev = dp->dev;
+  d->dinum = dp->inum;
+  strncpy(d->name, name, DIRSIZ);
+  d->inum = inum;
+  d->off = off;
+  release(&dcache.lock);
+}
+
+static void
+dcforget(struct inode *dp, char *name)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  d = dslot(dp->dev, dp->inum, name);
+  if(d->dinum == dp->inum && d->dev == dp->dev && namecmp(d->name, name) == 0)
+    d->dinum = 0;
+  release(&dcache.lock);
+}
+
+// Forget the cached entries of directory dinum on dev,
+// or of every directory on dev if dinum is 0.
+void
+dcpurge(uint dev, uint dinum)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.d; d < &dcache.d[NDENTRY]; d++){
+    if(d->dev == dev && (dinum == 0 || d->dinum == dinum))
+      d->dinum = 0;
+  }
+  release(&dcache.lock);
+}
+
+// Bucket b's first block, in a hashed directory's block 0.
+static ushort*
+dhead(struct buf *bp, uint b)
+{
+  return &((struct dirslot*)bp->data)[1 + b/NSLOTNEXT].next[b%NSLOTNEXT];
+}
+
+// The next block of the chain, in a hashed directory block.
+static ushort*
+dnext(struct buf *bp)
+{
+  return &((struct dirslot*)bp->data)[DPB-1].next[0];
+}
+
+// Index of a free dirent in a hashed directory block,
+// or DPB-1 if it is full.
+static uint
+dfree(struct buf *bp)
+{
+  struct dirent *de = (struct dirent*)bp->data;
+  uint i;
+
+  for(i = 0; i < DPB-1; i++)
+    if(de[i].inum == 0)
+      break;
+  return i;
+}
+
+// Find name in legacy directory dp by reading every entry.
+static uint
+llookup(struct inode *dp, char *name, uint *poff)
+{
+  uint off;
+  struct dirent de;
 
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -564,13 +783,132 @@ dirlookup(struct inode *dp, char *name, uint *poff)
       continue;
     if(namecmp(name, de.name) == 0){
       // entry matches path element
-      if(poff)
-        *poff = off;
-      inum = de.inum;
-      return iget(dp->dev, inum);
+      *poff = off;
+      return de.inum;
     }
   }
+  return 0;
+}
 
+// Find name in hashed directory dp by reading block 0
+// and the blocks of name's chain.
+static uint
+hlookup(struct inode *dp, char *name, uint *poff)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint bn, i, inum;
+
+  if(dp->size == 0)
+    return 0;
+  bp = bread(dp->dev, bmap(dp, 0));
+  bn = *dhead(bp, namehash(name) % NDIRBUCKET);
+  brelse(bp);
+  while(bn != 0){
+    if(bn >= dp->size / BSIZE)
+      panic("hlookup: bad chain");
+    bp = bread(dp->dev, bmap(dp, bn));
+    de = (struct dirent*)bp->data;
+    for(i = 0; i < DPB-1; i++){
+      if(de[i].inum != 0 && namecmp(name, de[i].name) == 0){
+        *poff = bn*BSIZE + i*sizeof(*de);
+        inum = de[i].inum;
+        brelse(bp);
+        return inum;
+      }
+    }
+    bn = *dnext(bp);
+    brelse(bp);
+  }
+  return 0;
+}
+
+// Look for a directory entry in a directory.
+// If found, set *poff to byte offset of entry.
+struct inode*
+dirlookup(struct inode *dp, char *name, uint *poff)
+{
+  uint off, inum;
+
+  if(dp->type != T_DIR)
+    panic("dirlookup not DIR");
+
+  if(!dcget(dp, name, &inum, &off)){
+    if(dp->major == DIRHASHED)
+      inum = hlookup(dp, name, &off);
+    else
+      inum = llookup(dp, name, &off);
+    if(inum == 0)
+      return 0;
+    dcput(dp, name, inum, off);
+  }
+  if(poff)
+    *poff = off;
+  return iget(dp->dev, inum);
+}
+
+// Add (name, inum) to hashed directory dp: in a free slot of
+// a block of name's chain; else, if the chain is empty, in
+// dp's last block when that ends its own chain; else in a
+// new block put at the front of the chain. Writes at most
+// block 0, one directory block, and what bmap() allocates.
+static int
+hlink(struct inode *dp, char *name, uint inum)
+{
+  struct buf *hp, *bp;
+  struct dirent *de;
+  ushort *head;
+  uint bn, i;
+
+  if(dp->size == 0){
+    if(bmap(dp, 0) == 0)
+      return -1;
+    dp->size = BSIZE;
+    iupdate(dp);
+  }
+  hp = bread(dp->dev, bmap(dp, 0));
+  head = dhead(hp, namehash(name) % NDIRBUCKET);
+
+  bn = *head;
+  while(bn != 0){
+    bp = bread(dp->dev, bmap(dp, bn));
+    if((i = dfree(bp)) < DPB-1)
+      goto found;
+    bn = *dnext(bp);
+    brelse(bp);
+  }
+
+  bn = dp->size/BSIZE - 1;
+  if(*head == 0 && bn > 0){
+    bp = bread(dp->dev, bmap(dp, bn));
+    if(*dnext(bp) == 0 && (i = dfree(bp)) < DPB-1){
+      *head = bn;
+      log_write(hp);
+      goto found;
+    }
+    brelse(bp);
+  }
+
+  bn = dp->size/BSIZE;
+  if(bn > 0xffff || bmap(dp, bn) == 0){
+    brelse(hp);
+    return -1;
+  }
+  dp->size += BSIZE;
+  iupdate(dp);
+  bp = bread(dp->dev, bmap(dp, bn));
+  *dnext(bp) = *head;
+  *head = bn;
+  log_write(hp);
+  i = 0;
+
+found:
+  de = (struct dirent*)bp->data + i;
+  strncpy(de->name, name, DIRSIZ);
+  de->inum = inum;
+  log_write(bp);
+  brelse(bp);
+  brelse(hp);
   return 0;
 }
 
@@ -589,6 +927,9 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
+  if(dp->major == DIRHASHED)
+    return hlink(dp, name, inum);
+
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -605,6 +946,18 @@ dirlink(struct inode *dp, char *name, uint inum)
   return 0;
 }
 
+// Remove the entry for name, at byte offset off, from dp.
+void
+dirunlink(struct inode *dp, char *name, uint off)
+{
+  struct dirent de;
+
+  dcforget(dp, name);
+  memset(&de, 0, sizeof(de));
+  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+    panic("unlink: writei");
+}
+
 // Paths
 
 // Copy the next path element from path into name.
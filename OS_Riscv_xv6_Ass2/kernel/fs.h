@@ -24,9 +24,10 @@ struct superblock {
 
 #define FSMAGIC 0x10203040
 
-#define NDIRECT 12
+#define NDIRECT 11
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NDINDIRECT (NINDIRECT * NINDIRECT)
+#define MAXFILE (NDIRECT + NINDIRECT + NDINDIRECT)
 
 // On-disk inode structure
 struct dinode {
@@ -35,7 +36,7 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint addrs[NDIRECT+2];   // Data block addresses
 };
 
 // Inodes per block.
@@ -58,3 +59,21 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// A directory whose inode has major == DIRHASHED is hashed.
+// Its block 0 is an array of dirslots listing the first block
+// of each of NDIRBUCKET chains; every other block holds DPB-1
+// dirents and, last, a dirslot whose next[0] is the following
+// block of its chain, or 0. A name hashes to a chain and is in
+// one of its blocks; chains may share their last block, so
+// small directories stay small. Others are plain dirent arrays.
+#define DIRHASHED  1
+#define NDIRBUCKET 128
+#define DPB        (BSIZE / sizeof(struct dirent))  // dirents per block
+#define NSLOTNEXT  7  // ushorts after the zero in a dirent-sized slot
+
+// Overlays a dirent whose inum is 0, so that programs
+// reading a hashed directory skip its bookkeeping.
+struct dirslot {
+  ushort zero;
+  ushort next[NSLOTNEXT];
+};
@@ -6,19 +6,22 @@
 #include "proc.h"
 #include "defs.h"
 
-extern struct proc proc[NPROC];
+// Kernel threads come from one table shared by all processes,
+// so that a process pays only for the kthreads it has. Each
+// process links its own through kt->tnext. A kthread's kernel
+// stack is a page from kalloc(), used through the kernel's
+// direct mapping of RAM, so it has no guard page; its trapframe
+// is a slot in one of its process's trapframe pages.
+struct kthread kthread[NKTHREAD];
 
-void kthreadinit(struct proc *p)
+void kthreadinit(void)
 {
-  initlock(&p->id_lock, "tid_lock");
-  for (struct kthread *kt = p->kthread; kt < &p->kthread[NKT]; kt++)
+  struct kthread *kt;
+
+  for (kt = kthread; kt < &kthread[NKTHREAD]; kt++)
   {
     initlock(&kt->t_lock, "thread");
     kt->t_state = Kthread_UNUSED;
-    // kt->pcb = p;
-    // WARNING: Don't change this line!
-    // get the pointer to the kernel stack of the kthread
-    kt->kstack = KSTACK((int)((p - proc) * NKT + (kt - p->kthread)));
   }
 }
 
@@ -33,7 +36,7 @@ struct kthread *mykthread()
 
 struct trapframe *get_kthread_trapframe(struct proc *p, struct kthread *kt)
 {
-  return p->base_trapframes + ((int)(kt - p->kthread));
+  return p->tfpages[kt->tfidx / TFPERPAGE] + kt->tfidx % TFPERPAGE;
 }
 
 int
@@ -48,11 +51,47 @@ allockid(struct proc *p)
   return kid;
 }
 
+// Find p a free trapframe slot, allocating and mapping
+// the page it is in if need be. Returns -1 if none.
+static int
+alloctf(struct proc *p)
+{
+  int i, pg;
+
+  for(i = 0; i < NKT && p->tfused[i]; i++)
+    ;
+  if(i == NKT)
+    return -1;
+  pg = i / TFPERPAGE;
+  if(p->tfpages[pg] == 0){
+    if((p->tfpages[pg] = (struct trapframe *)kalloc()) == 0)
+      return -1;
+    if(mappages(p->pagetable, TRAPFRAME(pg * TFPERPAGE), PGSIZE,
+                (uint64)p->tfpages[pg], PTE_R | PTE_W) < 0){
+      kfree((void*)p->tfpages[pg]);
+      p->tfpages[pg] = 0;
+      return -1;
+    }
+  }
+  return i;
+}
+
+// Add a kthread with a kernel stack and a trapframe to p.
+// Caller must hold p->p_lock. Returns with kt->t_lock held,
+// or 0 if p has NKT kthreads or memory runs out.
 struct kthread*
 allocKthread(struct proc *p)
 {
   struct kthread *kt;
-  for (kt = p->kthread; kt < &p->kthread[NKT]; kt++){
+  char *kstack;
+  int tf;
+
+  if((tf = alloctf(p)) < 0)
+    return 0;
+  if((kstack = kalloc()) == 0)
+    return 0;
+
+  for (kt = kthread; kt < &kthread[NKTHREAD]; kt++){
     acquire(&kt->t_lock);
     if(kt->t_state == Kthread_UNUSED) {
       goto found;
@@ -60,30 +99,55 @@ allocKthread(struct proc *p)
       release(&kt->t_lock);
     }
   }
+  kfree(kstack);
   return 0;
 
 found:
   kt->tid = allockid(p);
   kt->t_state = Kthread_USED;
   kt->pcb = p;
+  kt->cpu = -1;
+  kt->affinity = ALLHARTS;
+  kt->kstack = (uint64)kstack;
+  kt->tfidx = tf;
+  p->tfused[tf] = 1;
   kt->trapframe = get_kthread_trapframe(p, kt);
+  kt->tnext = p->kthreads;
+  p->kthreads = kt;
+  p->nkthread++;
   memset(&kt->context, 0, sizeof(kt->context));
   kt->context.ra = (uint64)forkret;
   kt->context.sp = kt->kstack + PGSIZE;
-  
+
   return kt;
 }
 
+// Take kt off its process's list and free its kernel stack
+// and trapframe slot. kt must not be running. Caller must
+// hold kt->t_lock and kt->pcb->p_lock.
 void
 freeKthread(struct kthread *kt)
 {
+  struct proc *p = kt->pcb;
+  struct kthread **pp;
+
+  if(p){
+    for(pp = &p->kthreads; *pp != kt; pp = &(*pp)->tnext)
+      ;
+    *pp = kt->tnext;
+    p->nkthread--;
+    p->tfused[kt->tfidx] = 0;
+  }
+  if(kt->kstack)
+    kfree((void*)kt->kstack);
+  kt->kstack = 0;
   kt->trapframe = 0;
+  kt->tfidx = 0;
+  kt->tnext = 0;
   kt->chan = 0;
-  //memset(&kt->context, 0, sizeof(kt->context));
-  //kt->kstack = 0;
   kt->pcb = 0;
   kt->t_killed = 0;
   kt->t_state = Kthread_UNUSED;
   kt->t_xstate = 0;
   kt->tid = 0;
-}
\ No newline at end of file
+}
@@ -50,6 +50,11 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// A process's trapframes are packed TFPERPAGE to a page,
+// and its pages are allocated as its kthreads need them.
+#define TFPERPAGE (PGSIZE / sizeof(struct trapframe))
+#define NTFPAGE   ((NKT + TFPERPAGE - 1) / TFPERPAGE)
+
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -76,19 +81,32 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int idle;                   // In wfi in scheduler(), or about to be.
+  int resched;                // Set with an IPI to make thrd yield.
+  uint64 uepoch;              // Odd while running user code.
+  uint64 npick;               // kthreads scheduler() has picked,
+  uint64 pickcycles;          // and the mtime cycles it took;
+  uint64 spincycles;          // cycles it looked and found nothing;
+  uint64 idlecycles;          // cycles it waited in wfi.
 };
 
 extern struct cpu cpus[NCPU];
 
+#define ALLHARTS ((1 << NCPU) - 1)
+
 enum Kthreadstate{ Kthread_UNUSED, Kthread_USED, SLEEPING, RUNNABLE, RUNNING, Kthread_ZOMBIE };
 
 
 struct kthread
 {
 
-  uint64 kstack;                // Virtual address of kernel stack
+  uint64 kstack;                // Kernel stack page, from kalloc()
+
+  struct trapframe *trapframe;  // in a data page for trampoline.S
 
-  struct trapframe *trapframe;  // data page for trampoline.S
+  int tfidx;                    // trapframe slot; see TRAPFRAME()
+
+  struct kthread *tnext;        // Next kthread of pcb, under pcb->p_lock
 
   struct spinlock t_lock;
 
@@ -96,6 +114,16 @@ struct kthread
 
   void *chan;                  // If non-zero, sleeping on chan
 
+  struct waitq *wq;            // Wait queue kt sleeps on, or null
+
+  struct kthread *wqnext;      // Next sleeper in wq
+
+  struct kthread *rqnext;      // Next in its hart's run queue
+
+  int cpu;                     // Hart it last ran on, or -1
+
+  int affinity;                // Mask of harts it may run on
+
   int t_killed;                  // If non-zero, have been killed
 
   int t_xstate;                  // Exit status to be returned to parent's wait
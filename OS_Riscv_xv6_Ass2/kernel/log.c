@@ -10,30 +10,49 @@
 // Simple logging that allows concurrent FS system calls.
 //
 // A log transaction contains the updates of multiple FS system
-// calls. The logging system only commits when there are
-// no FS system calls active. Thus there is never
-// any reasoning required about whether a commit might
-// write an uncommitted system call's updates to disk.
+// calls. A transaction is only closed when there are no FS
+// system calls active in it. Thus there is never any reasoning
+// required about whether a commit might write an uncommitted
+// system call's updates to disk.
 //
 // A system call should call begin_op()/end_op() to mark
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
-// But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// But if it thinks the log is close to running out, or the
+// open transaction has waited long enough, it sleeps until
+// the transaction is closed.
+//
+// Commits are group commits, done by the logflush kernel
+// process. It closes the open transaction whenever no call
+// is active in it, copies its blocks to the log's buffers,
+// and opens a new transaction at once; the disk writes then
+// happen while new calls fill the new transaction. Calls
+// that end during a commit wait for the next one, so a busy
+// file system commits many calls at a time. end_op() does
+// not wait for the commit; fsync() does.
 //
 // The log is a physical re-do log containing disk blocks.
-// The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
+// It has two halves, used by alternate transactions, so a
+// transaction can commit while the one before it is still
+// in the other half. The on-disk format of each half:
+//   header block, containing a sequence number and
+//     block #s for block A, B, C, ...
 //   block A
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+//
+// Installing a transaction writes its home blocks from the
+// buffer cache, which may by then hold changes from the next
+// transaction. That transaction's header stays on disk until
+// the one after it has committed, so recovery, which replays
+// both halves oldest first, undoes any such early writes.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
 struct logheader {
   int n;
+  uint seq;
   int block[LOGSIZE];
 };
 
@@ -42,84 +61,129 @@ struct log {
   int start;
   int size;
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int closing;     // copying the open transaction, please wait.
+  int force;       // fsync() is waiting; close soon.
+  uint64 opened;   // r_time() of the open transaction's first block.
+  uint seq;        // sequence number of the open transaction.
+  uint durable;    // last sequence number committed to disk.
+  int half;        // half of the log the open transaction will use.
   int dev;
-  struct logheader lh;
+  struct logheader lh;  // open transaction.
+
+  // private to logflusher().
+  struct logheader clh; // transaction being committed.
+  int live[2];          // does each half's header list blocks?
+
+  uint64 nop;      // statistics for logstat().
+  uint64 ncommit;
+  uint64 nblocks;
 };
 struct log log;
 
 static void recover_from_log(void);
-static void commit();
+static void logflusher(void);
 
 void
 initlog(int dev, struct superblock *sb)
 {
   if (sizeof(struct logheader) >= BSIZE)
     panic("initlog: too big logheader");
+  if (sb->nlog < 2*(LOGSIZE+1))
+    panic("initlog: log too small");
 
   initlock(&log.lock, "log");
   log.start = sb->logstart;
   log.size = sb->nlog;
   log.dev = dev;
   recover_from_log();
+  kproc("logflush", logflusher);
 }
 
-// Copy committed blocks from log to their home location
+// Block number of half h's header; its log blocks follow.
+static int
+halfstart(int h)
+{
+  return log.start + h*(LOGSIZE+1);
+}
+
+// Copy committed blocks from log half h to their home locations.
+// After a commit the cache already holds them, so they
+// only need to be marked dirty for bflush().
 static void
-install_trans(int recovering)
+install_trans(struct logheader *lh, int h, int recovering)
 {
   int tail;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
+  for (tail = 0; tail < lh->n; tail++) {
+    struct buf *lbuf = 0;
+    if(recovering)
+      lbuf = bread(log.dev, halfstart(h)+tail+1); // read log block
+    struct buf *dbuf = bread(log.dev, lh->block[tail]); // read dst
+    if(recovering){
+      memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+    }
+    bdirty(dbuf);  // bflush() writes dst to disk
     if(recovering == 0)
       bunpin(dbuf);
-    brelse(lbuf);
     brelse(dbuf);
   }
 }
 
-// Read the log header from disk into the in-memory log header
+// Read half h's log header from disk into lh.
 static void
-read_head(void)
+read_head(int h, struct logheader *lh)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
+  struct buf *buf = bread(log.dev, halfstart(h));
+  struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
+  lh->n = hb->n;
+  lh->seq = hb->seq;
+  for (i = 0; i < lh->n; i++) {
+    lh->block[i] = hb->block[i];
   }
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
+// Write lh to half h's header on disk.
 // This is the true point at which the
-// current transaction commits.
+// transaction commits.
 static void
-write_head(void)
+write_head(int h, struct logheader *lh)
 {
-  struct buf *buf = bread(log.dev, log.start);
+  struct buf *buf = bread(log.dev, halfstart(h));
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
+  hb->n = lh->n;
+  hb->seq = lh->seq;
+  for (i = 0; i < lh->n; i++) {
+    hb->block[i] = lh->block[i];
   }
   bwrite(buf);
   brelse(buf);
+  log.live[h] = lh->n > 0;
 }
 
 static void
 recover_from_log(void)
 {
-  read_head();
-  install_trans(1); // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head(); // clear the log
+  struct logheader lh[2];
+  int h, first;
+
+  read_head(0, &lh[0]);
+  read_head(1, &lh[1]);
+  // if committed, copy from log to disk, oldest first.
+  first = lh[0].seq <= lh[1].seq ? 0 : 1;
+  install_trans(&lh[first], first, 1);
+  install_trans(&lh[first^1], first^1, 1);
+  bflush(log.dev);
+  // clear the log
+  for (h = 0; h < 2; h++) {
+    lh[h].n = 0;
+    write_head(h, &lh[h]);
+  }
+  log.seq = (lh[0].seq > lh[1].seq ? lh[0].seq : lh[1].seq) + 1;
+  log.durable = log.seq - 1;
 }
 
 // called at the start of each FS system call.
@@ -128,13 +192,23 @@ begin_op(void)
 {
   acquire(&log.lock);
   while(1){
-    if(log.committing){
+    if(log.closing){
+      sleep(&log, &log.lock);
+    } else if(log.lh.n > 0 &&
+              (log.force || r_time() - log.opened > COMMITWAIT)){
+      // let the open transaction drain, so that
+      // logflusher() can close and commit it.
       sleep(&log, &log.lock);
     } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      log.nop++;
+      // the waiters were woken one at a time; pass
+      // the turn on if there is room for another op.
+      if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS <= LOGSIZE)
+        wakeup_one(&log);
       release(&log.lock);
       break;
     }
@@ -142,69 +216,150 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// lets logflusher() commit if this was the last
+// outstanding operation.
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
-  if(log.committing)
-    panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
-  }
+  if(log.outstanding == 0)
+    wakeup(&log.outstanding);
+  // begin_op() may be waiting for log space,
+  // and decrementing log.outstanding has decreased
+  // the amount of reserved space.
+  wakeup_one(&log);
   release(&log.lock);
-
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
-  }
 }
 
-// Copy modified blocks from cache to log.
+// Copy the closed transaction's blocks from cache to the
+// log buffers of half h. No FS system call is active, so
+// the copies are consistent.
 static void
-write_log(void)
+copy_log(int h)
 {
   int tail;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
+  for (tail = 0; tail < log.clh.n; tail++) {
+    struct buf *to = bclaim(log.dev, halfstart(h)+tail+1); // log block
+    struct buf *from = bread(log.dev, log.clh.block[tail]); // cache block
     memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    bdirty(to);
     brelse(from);
     brelse(to);
   }
 }
 
+// Write the closed transaction to log half h. The log blocks
+// are adjacent, so bflush() writes them in a few requests;
+// they are the only dirty buffers.
+static void
+commit(int h)
+{
+  bflush(log.dev);      // Write the log blocks
+  write_head(h, &log.clh); // Write header to disk -- the real commit
+}
+
+// Install the transaction just committed to half h, and
+// erase the one before it from the other half: its early
+// writes of this transaction's blocks are now covered.
+// bflush() writes all of it at once, in any order.
 static void
-commit()
+install(int h)
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(0); // Now install writes to home locations
+  struct buf *buf;
+
+  if(log.live[h^1]){
+    buf = bread(log.dev, halfstart(h^1));
+    ((struct logheader *) (buf->data))->n = 0;
+    bdirty(buf);
+    brelse(buf);
+    log.live[h^1] = 0;
+  }
+  install_trans(&log.clh, h, 0);
+  bflush(log.dev);
+}
+
+// The logflush kernel process: commit and install one
+// transaction at a time.
+static void
+logflusher(void)
+{
+  int h;
+
+  acquire(&log.lock);
+  for(;;){
+    if(log.lh.n == 0 || log.outstanding > 0){
+      sleep(&log.outstanding, &log.lock);
+      continue;
+    }
+
+    // close the open transaction and open the next.
+    log.closing = 1;
+    log.clh = log.lh;
+    log.clh.seq = log.seq++;
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.force = 0;
+    h = log.half;
+    log.half ^= 1;
+    release(&log.lock);
+
+    copy_log(h);
+
+    acquire(&log.lock);
+    log.closing = 0;
+    wakeup_one(&log);
+    release(&log.lock);
+
+    commit(h);
+
+    acquire(&log.lock);
+    log.durable = log.clh.seq;
+    log.ncommit++;
+    log.nblocks += log.clh.n;
+    wakeup(&log.durable);
+    release(&log.lock);
+
+    install(h);
+
+    acquire(&log.lock);
   }
 }
 
+// Wait until the writes of every FS system call that has
+// returned are committed to disk.
+void
+log_sync(void)
+{
+  uint want;
+
+  acquire(&log.lock);
+  // they are in the open transaction if it has blocks,
+  // else in the one before it, which may be committing.
+  want = log.lh.n > 0 ? log.seq : log.seq - 1;
+  while(log.durable < want){
+    if(log.lh.n > 0 && log.seq == want)
+      log.force = 1;
+    sleep(&log.durable, &log.lock);
+  }
+  release(&log.lock);
+}
+
+// Fill st[0..2] with the FS system calls begun, the
+// transactions committed, and the blocks they logged.
+void
+log_stat(uint64 *st)
+{
+  acquire(&log.lock);
+  st[0] = log.nop;
+  st[1] = log.ncommit;
+  st[2] = log.nblocks;
+  release(&log.lock);
+}
+
 // Caller has modified b->data and is done with the buffer.
 // Record the block number and pin in the cache by increasing refcnt.
-// commit()/write_log() will do the disk write.
+// logflusher() will do the disk write.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -217,7 +372,7 @@ log_write(struct buf *b)
   int i;
 
   acquire(&log.lock);
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.lh.n >= LOGSIZE)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
@@ -229,8 +384,9 @@ log_write(struct buf *b)
   log.lh.block[i] = b->blockno;
   if (i == log.lh.n) {  // Add new block to log?
     bpin(b);
+    if (log.lh.n == 0)
+      log.opened = r_time();
     log.lh.n++;
   }
   release(&log.lock);
 }
-
@@ -27,6 +27,7 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid)) // write 1 to interrupt hart.
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
 
@@ -51,10 +52,6 @@
 // in both user and kernel space.
 #define TRAMPOLINE (MAXVA - PGSIZE)
 
-// map kernel stacks beneath the trampoline,
-// each surrounded by invalid guard pages.
-#define KSTACK(p) (TRAMPOLINE - ((p)+1)* 2*PGSIZE)
-
 // User memory layout.
 // Address zero first:
 //   text
@@ -62,6 +59,9 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
-//   TRAPFRAME (kt->trapframe, used by the trampoline)
+//   TRAPFRAME pages (kt->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
-#define TRAPFRAME(kt_idx) (TRAMPOLINE - PGSIZE + (kt_idx * sizeof(struct trapframe)))
+// trapframe slot i is in the (i/TFPERPAGE)'th page below
+// the trampoline.
+#define TRAPFRAME(i) (TRAMPOLINE - ((i) / TFPERPAGE + 1) * PGSIZE + \
+                      ((i) % TFPERPAGE) * sizeof(struct trapframe))
@@ -1,15 +1,25 @@
 #define NPROC        64  // maximum number of processes
-#define NKT          10  // maximum number of kernel threads
+#define NKT         256  // maximum number of kernel threads per process
+#define NKTHREAD    512  // maximum number of kernel threads
 #define NCPU          8  // maximum number of CPUs
+#define NWAITQ       61  // sleep()/wakeup() hash buckets
+#define NFUTEX       31  // futex_wait()/futex_wake() lock buckets
+#define TLBBATCH     64  // pages uvmunmap() frees per TLB shootdown
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
+#define NDENTRY     256  // directory entries in the name lookup cache
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks
+#define LOGSIZE      (MAXOPBLOCKS*6)  // max data blocks in each half of the log
+#define NBUF         (LOGSIZE*3)  // minimum size of disk block cache
+#define COMMITWAIT   100000  // cycles (10 ms) a transaction admits new ops
+#define BUFPCT       10  // percent of free memory for the block cache
+#define MAXBATCH     32  // most blocks one read() has in flight
+#define MAXREADAHEAD 64  // largest read-ahead window, in blocks
+#define MAXRUN       16  // most adjacent blocks in one disk request
+#define FSSIZE       70000  // size of file system in blocks; fits a MAXFILE file
 #define MAXPATH      128   // maximum file path name
 #define MAX_STACK_SIZE 4000
\ No newline at end of file
@@ -26,25 +26,6 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->p_lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl)
-{
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    for (struct kthread *kt = p->kthread; kt < &p->kthread[NKT]; kt++) {
-      char *pa = kalloc();
-      if(pa == 0)
-        panic("kalloc");
-      uint64 va = KSTACK((int) ((p - proc) * NKT + (kt - p->kthread)));
-      kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-    }
-  }
-}
-
 // initialize the proc table.
 void
 procinit(void)
@@ -55,9 +36,13 @@ procinit(void)
   initlock(&wait_lock, "wait_lock");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->p_lock, "proc");
+      initlock(&p->id_lock, "tid_lock");
       p->p_state = UNUSED;
-      kthreadinit(p);
   }
+  kthreadinit();
+  waitqinit();
+  runqinit();
+  futexinit();
 }
 
 // Must be called with interrupts disabled,
@@ -130,13 +115,6 @@ found:
   
   p->pid = allocpid();
   
-  
-  // Allocate a trapframe page.
-  if((p->base_trapframes = (struct trapframe *)kalloc()) == 0){
-    freeproc(p);
-    release(&p->p_lock);
-    return 0;
-  }
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
@@ -147,7 +125,12 @@ found:
   
   p->counter = 1;
 
-  allocKthread(p);
+  // The first kthread, and with it a trapframe page.
+  if(allocKthread(p) == 0){
+    freeproc(p);
+    release(&p->p_lock);
+    return 0;
+  }
   
   return p;
 }
@@ -158,21 +141,26 @@ found:
 static void
 freeproc(struct proc *p)
 {
-  
-  if(p->base_trapframes)
-    kfree((void*)p->base_trapframes);
-  p->base_trapframes = 0;
-  
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
-  p->pagetable = 0;
   struct kthread *kt;
-  
-  for(kt = p->kthread; kt < &p->kthread[NKT];kt++){
+  int i;
+
+  // an exited kthread's t_lock is held until
+  // it has switched away from its stack.
+  while((kt = p->kthreads) != 0){
     acquire(&kt->t_lock);
     freeKthread(kt);
     release(&kt->t_lock);
   }
+
+  if(p->pagetable)
+    proc_freepagetable(p->pagetable, p->sz);
+  p->pagetable = 0;
+
+  for(i = 0; i < NTFPAGE; i++){
+    if(p->tfpages[i])
+      kfree((void*)p->tfpages[i]);
+    p->tfpages[i] = 0;
+  }
   
   p->sz = 0;
   p->pid = 0;
@@ -180,6 +168,7 @@ freeproc(struct proc *p)
   p->name[0] = 0;
   p->p_killed = 0;
   p->p_xstate = 0;
+  p->gang = 0;
   p->p_state = UNUSED;
 }
 
@@ -205,25 +194,51 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
-  // map the trapframe page just below the trampoline page, for
-  // trampoline.S.
-  if(mappages(pagetable, TRAPFRAME(0), PGSIZE,
-              (uint64)(p->base_trapframes), PTE_R | PTE_W) < 0){
-    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-    uvmfree(pagetable, 0);
+  // map p's trapframe pages just below the trampoline page,
+  // for trampoline.S. allocKthread() maps any more.
+  if(proc_maptf(p, pagetable) < 0){
+    proc_freepagetable(pagetable, 0);
     return 0;
   }
 
   return pagetable;
 }
 
+// Map those of p's trapframe pages that pagetable lacks.
+int
+proc_maptf(struct proc *p, pagetable_t pagetable)
+{
+  pte_t *pte;
+  int i;
+
+  for(i = 0; i < NTFPAGE; i++){
+    if(p->tfpages[i] == 0)
+      continue;
+    pte = walk(pagetable, TRAPFRAME(i * TFPERPAGE), 0);
+    if(pte && (*pte & PTE_V))
+      continue;
+    if(mappages(pagetable, TRAPFRAME(i * TFPERPAGE), PGSIZE,
+                (uint64)(p->tfpages[i]), PTE_R | PTE_W) < 0)
+      return -1;
+  }
+  return 0;
+}
+
 // Free a process's page table, and free the
-// physical memory it refers to.
+// physical memory it refers to, except for
+// the trapframe pages, which freeproc() frees.
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
+  pte_t *pte;
+  int i;
+
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME(0), 1, 0);
+  for(i = 0; i < NTFPAGE; i++){
+    pte = walk(pagetable, TRAPFRAME(i * TFPERPAGE), 0);
+    if(pte && (*pte & PTE_V))
+      uvmunmap(pagetable, TRAPFRAME(i * TFPERPAGE), 1, 0);
+  }
   uvmfree(pagetable, sz);
 }
 
@@ -254,17 +269,50 @@ userinit(void)
   p->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
-  p->kthread[0].trapframe->epc = 0;      // user program counter
-  p->kthread[0].trapframe->sp = PGSIZE;  // user stack pointer
+  p->kthreads->trapframe->epc = 0;      // user program counter
+  p->kthreads->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
   //p->p_state = USED;
 
-  p->kthread[0].t_state = RUNNABLE;
+  setrunnable(p->kthreads);
 
-  release(&p->kthread[0].t_lock);
+  release(&p->kthreads->t_lock);
+
+  release(&p->p_lock);
+}
+
+// A kproc's very first scheduling by scheduler()
+// will swtch to kprocret.
+static void
+kprocret(void)
+{
+  // Still holding kt->t_lock from scheduler.
+  release(&mykthread()->t_lock);
+
+  myproc()->kmain();
+  panic("kproc returned");
+}
+
+// Start a kernel-only process, whose one kthread runs
+// fn(), which must never return. It has no user memory
+// and never leaves the kernel.
+void
+kproc(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kproc");
+  p->kmain = fn;
+  p->kthreads->context.ra = (uint64)kprocret;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  setrunnable(p->kthreads);
+
+  release(&p->kthreads->t_lock);
 
   release(&p->p_lock);
 }
@@ -306,18 +354,21 @@ fork(void)
 
   // Copy user memory from parent to child.
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+    release(&np->kthreads->t_lock);
     freeproc(np);
-    //freeKthread(&np->kthread[0]);
     release(&np->p_lock);
     return -1;
   }
   np->sz = p->sz;
 
   // copy saved user registers.
-  *(np->kthread[0].trapframe) = *(kt->trapframe);
+  *(np->kthreads->trapframe) = *(kt->trapframe);
 
   // Cause fork to return 0 in the child.
-  np->kthread[0].trapframe->a0 = 0;
+  np->kthreads->trapframe->a0 = 0;
+
+  // the child runs where its parent may.
+  np->kthreads->affinity = kt->affinity;
 
   // increment reference counts on open file descriptors.
   for(i = 0; i < NOFILE; i++)
@@ -329,7 +380,7 @@ fork(void)
 
   pid = np->pid;
 
-  release(&np->kthread[0].t_lock);
+  release(&np->kthreads->t_lock);
   release(&np->p_lock);
 
   acquire(&wait_lock);
@@ -337,10 +388,10 @@ fork(void)
   release(&wait_lock);
 
   acquire(&np->p_lock);
-  acquire(&np->kthread[0].t_lock);
-  np->kthread[0].t_state = RUNNABLE;
+  acquire(&np->kthreads->t_lock);
+  setrunnable(np->kthreads);
   //np->p_state = USED; ////////////////////////////////////////////////////////////////////////////
-  release(&np->kthread[0].t_lock);
+  release(&np->kthreads->t_lock);
   release(&np->p_lock);
 
   return pid;
@@ -370,15 +421,11 @@ exit(int status)
   struct proc *p = myproc();
   struct kthread *t = mykthread();
 
-  for(struct kthread *kt = p->kthread; kt < &p->kthread[NKT]; kt++){
-    if(t != kt){
-       int changer = 1;
-      kthread_join(kt->tid, (uint64)&changer);
-    }
-  }
   if(p == initproc)
     panic("init exiting");
 
+  kthread_reapothers();
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -407,25 +454,13 @@ exit(int status)
   
   p->p_state = ZOMBIE;
 
-  // for(struct kthread *kt = p->kthread; kt < &p->kthread[NKT]; kt++){
-  //   acquire(&kt->t_lock);
-  //   freeKthread(kt);
-  //   if(kt != mykthread())
-  //     release(&kt->t_lock);
-  // }
-
-  // struct kthread *kt = mykthread();
-  // acquire(&kt->t_lock);
-  // kt->t_state = ZOMBIE;
-  // kt->t_xstate = status;
+  // wait()'s freeproc() frees t, once the scheduler
+  // has switched away from it and released t->t_lock.
+  acquire(&t->t_lock);
+  t->t_state = Kthread_ZOMBIE;
   
   release(&p->p_lock);
   release(&wait_lock);
-  
-
-  acquire(&t->t_lock);
-  
-  freeKthread(t);
 
   // Jump into the scheduler, never to return.
   sched();
@@ -470,7 +505,7 @@ wait(uint64 addr)
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(!havekids || ktkilled()){
       release(&wait_lock);
       return -1;
     }
@@ -480,47 +515,388 @@ wait(uint64 addr)
   }
 }
 
+// Each hart has a queue of RUNNABLE kthreads, so that the
+// scheduler takes the next one to run without looking at
+// the kthreads that are not. A queue's lock protects its
+// list and the rqnext of the kthreads on it. A kthread is
+// on a queue exactly while it is RUNNABLE and no scheduler
+// has taken it yet. Lock order: kt->t_lock, then the queue.
+//
+// A kthread runs only on harts its affinity mask allows.
+// The kthreads of a gang process are scheduled together:
+// when one starts to run, its runnable siblings are put at
+// the heads of other harts' queues and those harts are made
+// to reschedule, and a sibling that wakes takes its hart
+// from a kthread of another process.
+struct runq {
+  struct spinlock lock;
+  struct kthread *head;
+  struct kthread *tail;
+};
+
+static struct runq runq[NCPU];
+
+static int onlineharts;   // harts that have entered scheduler()
+
+void
+runqinit(void)
+{
+  struct runq *rq;
+
+  for(rq = runq; rq < &runq[NCPU]; rq++)
+    initlock(&rq->lock, "runq");
+}
+
+// An idle hart in mask, or -1 if none is.
+static int
+idlehart(int mask)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    if((mask & (1 << i)) && cpus[i].idle)
+      return i;
+  return -1;
+}
+
+// The hart to queue kt on. One that yields stays on this
+// hart. One that wakes goes to the hart it last ran on, for
+// its cache, unless that hart is busy and another is idle.
+// A new one goes to an idle hart, to spread a process's
+// kthreads out. All within kt's affinity.
+static int
+target(struct kthread *kt)
+{
+  int me = cpuid();
+  int mask = kt->affinity & onlineharts;
+  int h;
+
+  if(mask == 0)
+    return me;   // still booting
+  if(kt == mycpu()->thrd){
+    if(mask & (1 << me))
+      return me;
+  } else if(kt->cpu >= 0 && (mask & (1 << kt->cpu))){
+    if(cpus[kt->cpu].idle || (h = idlehart(mask)) < 0)
+      return kt->cpu;
+    return h;
+  }
+  if((h = idlehart(mask)) >= 0)
+    return h;
+  if(mask & (1 << me))
+    return me;
+  for(h = 0; (mask & (1 << h)) == 0; h++)
+    ;
+  return h;
+}
+
+// Add kt to hart h's queue, at the head if first is set.
+static void
+enqueue(int h, struct kthread *kt, int first)
+{
+  struct runq *rq = &runq[h];
+
+  acquire(&rq->lock);
+  if(first || rq->head == 0){
+    kt->rqnext = rq->head;
+    rq->head = kt;
+    if(rq->tail == 0)
+      rq->tail = kt;
+  } else {
+    kt->rqnext = 0;
+    rq->tail->rqnext = kt;
+    rq->tail = kt;
+  }
+  release(&rq->lock);
+}
+
+// Take the first kthread off rq that may run on hart h,
+// and that belongs to p if p is set. Caller must hold
+// rq->lock.
+static struct kthread*
+dequeue(struct runq *rq, int h, struct proc *p)
+{
+  struct kthread *kt, *prev, **pp;
+
+  prev = 0;
+  for(pp = &rq->head; (kt = *pp) != 0; pp = &kt->rqnext){
+    if((kt->affinity & (1 << h)) && (p == 0 || kt->pcb == p)){
+      *pp = kt->rqnext;
+      if(rq->tail == kt)
+        rq->tail = prev;
+      return kt;
+    }
+    prev = kt;
+  }
+  return 0;
+}
+
+// Make hart h look at its queue: end its wfi, and with
+// preempt set, make the kthread it runs yield.
+static void
+kick(int h, int preempt)
+{
+  if(preempt)
+    cpus[h].resched = 1;
+  // pairs with the fence in scheduler() between setting
+  // idle and looking at the queues one last time.
+  __sync_synchronize();
+  if(preempt || cpus[h].idle)
+    ipi(h);
+}
+
+// Whether hart h runs a kthread of a process other than p.
+// Only a hint: it may have switched by the time we act.
+static int
+runsother(int h, struct proc *p)
+{
+  struct kthread *t = cpus[h].thrd;
+
+  return t != 0 && t->pcb != p;
+}
+
+// Make kt RUNNABLE and queue it. Caller must hold kt->t_lock.
+// An idle hart is sent an IPI to end its wfi.
+void
+setrunnable(struct kthread *kt)
+{
+  struct proc *p = kt->pcb;
+  int h, gang;
+
+  if(kt->t_state == RUNNABLE)
+    return;
+  kt->t_state = RUNNABLE;
+  gang = p && p->gang && kt != mycpu()->thrd;
+  h = target(kt);
+  enqueue(h, kt, gang);
+  if(h != cpuid())
+    kick(h, gang && runsother(h, p));
+}
+
+// kt of a gang process is about to run on hart id. Move
+// its runnable siblings to the heads of the queues of other
+// harts that run other processes, and make those harts
+// reschedule, so that the siblings run alongside it.
+// Caller holds kt->t_lock.
+static void
+gangcall(struct kthread *kt, int id)
+{
+  struct proc *p = kt->pcb;
+  struct kthread *s;
+  int h, i;
+
+  for(h = 0; h < NCPU; h++){
+    if(h == id || (onlineharts & (1 << h)) == 0)
+      continue;
+    if(cpus[h].thrd && !runsother(h, p))
+      continue;
+    s = 0;
+    for(i = 0; i < NCPU && s == 0; i++){
+      acquire(&runq[i].lock);
+      s = dequeue(&runq[i], h, p);
+      release(&runq[i].lock);
+    }
+    if(s == 0)
+      return;   // no more siblings are runnable
+    enqueue(h, s, 1);
+    kick(h, cpus[h].thrd != 0);
+  }
+}
+
+// Take a kthread that may run here off this hart's queue,
+// or else off another's, and return it locked. Returns 0
+// if none is queued.
+static struct kthread*
+pick(int id)
+{
+  struct runq *rq;
+  struct kthread *kt;
+  int i;
+
+  for(i = 0; i < NCPU; i++){
+    rq = &runq[(id + i) % NCPU];
+    if(rq->head == 0)
+      continue;   // don't lock queues that look empty
+    acquire(&rq->lock);
+    kt = dequeue(rq, id, 0);
+    release(&rq->lock);
+    if(kt){
+      acquire(&kt->t_lock);
+      if(kt->t_state != RUNNABLE)
+        panic("pick");
+      return kt;
+    }
+  }
+  return 0;
+}
+
+// Whether any queue holds a kthread that may run on hart
+// id. Kthreads pinned elsewhere don't count, or an idle
+// hart would spin while they wait for their busy harts.
+static int
+queued(int id)
+{
+  struct runq *rq;
+  struct kthread *kt;
+
+  for(rq = runq; rq < &runq[NCPU]; rq++){
+    if(rq->head == 0)
+      continue;   // don't lock queues that look empty
+    acquire(&rq->lock);
+    for(kt = rq->head; kt; kt = kt->rqnext)
+      if(kt->affinity & (1 << id))
+        break;
+    release(&rq->lock);
+    if(kt)
+      return 1;
+  }
+  return 0;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
-//  - eventually that process transfers control
+//  - take a kthread from the run queues.
+//  - swtch to start running that kthread.
+//  - eventually that kthread transfers control
 //    via swtch back to the scheduler.
+// When no kthread is runnable, the hart waits in wfi
+// for an interrupt instead of spinning.
 void
 scheduler(void)
 {
-  struct proc* p;
+  struct kthread *kt;
   struct cpu *c = mycpu();
+  int id = cpuid();
+  uint64 t0, t1;
 
   c->thrd = 0;
+  __sync_fetch_and_or(&onlineharts, 1 << id);
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->p_lock);
-      if(p->p_state == USED) {
-        release(&p->p_lock);
-        struct kthread *kt;
-        for(kt = p->kthread; kt < &p->kthread[NKT]; kt++){
-          acquire(&kt->t_lock);
-
-          if(kt->t_state == RUNNABLE){
-              kt->t_state = RUNNING;
-              c->thrd = kt;
-              swtch(&c->context, &kt->context);
-              c->thrd = 0;
-          }
+    t0 = r_time();
+    if((kt = pick(id)) == 0){
+      // With interrupts off, an interrupt that arrives
+      // after the last look still ends the wfi, since
+      // it stays pending. setrunnable() sends an IPI
+      // if it sees idle set.
+      intr_off();
+      c->idle = 1;
+      __sync_synchronize();
+      t1 = r_time();
+      c->spincycles += t1 - t0;
+      if(!queued(id)){
+        asm volatile("wfi");
+        c->idlecycles += r_time() - t1;
+      }
+      c->idle = 0;
+      continue;
+    }
+    c->npick++;
+    c->pickcycles += r_time() - t0;
 
-          release(&kt->t_lock);
+    kt->t_state = RUNNING;
+    kt->cpu = id;
+    c->thrd = kt;
+    if(kt->pcb && kt->pcb->gang)
+      gangcall(kt, id);
+    swtch(&c->context, &kt->context);
+    c->thrd = 0;
 
-        }
-      }
-      else{
-        release(&p->p_lock);
-      }
+    release(&kt->t_lock);
+  }
+}
+
+// Fill st[0..3] with the number of kthreads the schedulers
+// have picked, the mtime cycles it took them, the cycles
+// they spent finding nothing to run, and the cycles they
+// spent idle in wfi, summed over all harts.
+void
+schedstat(uint64 *st)
+{
+  struct cpu *c;
+
+  st[0] = st[1] = st[2] = st[3] = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    st[0] += c->npick;
+    st[1] += c->pickcycles;
+    st[2] += c->spincycles;
+    st[3] += c->idlecycles;
+  }
+}
+
+// TLB shootdown. The kthreads of a process share its page
+// table, so a hart running one of them in user mode may
+// hold translations that another has just removed, and must
+// not keep using them once their pages are freed. Harts in
+// the kernel hold none: uservec and userret flush the TLB
+// at each switch of page table, and the kernel walks user
+// page tables in software. So it is enough to interrupt the
+// harts in user mode of pagetable's process, and wait until
+// each has trapped into the kernel; cpu->uepoch counts
+// those switches.
+static struct {
+  uint64 nshoot;    // shootdowns that sent IPIs
+  uint64 nipi;      // IPIs they sent
+  uint64 cycles;    // mtime cycles spent waiting for them
+  uint64 npage;     // pages freed after shootdowns
+} tlb;
+
+// Make sure that no other hart still uses translations
+// from pagetable that were removed before the call, so
+// that the npage pages they mapped can be freed.
+void
+tlbshootdown(pagetable_t pagetable, int npage)
+{
+  uint64 epoch[NCPU];
+  struct kthread *kt;
+  struct proc *p;
+  uint64 t0;
+  int h, n = 0;
+
+  // order the caller's PTE stores before the loads of
+  // uepoch; pairs with the atomic add in usertrapret().
+  __sync_synchronize();
+  for(h = 0; h < NCPU; h++){
+    epoch[h] = __atomic_load_n(&cpus[h].uepoch, __ATOMIC_SEQ_CST);
+    if(epoch[h] % 2 == 0)
+      continue;
+    // h runs user code, and since uepoch is odd it cannot
+    // switch kthreads until it traps. If it has trapped
+    // since, thrd may be stale, but then h is safe anyway.
+    kt = cpus[h].thrd;
+    if(kt == 0 || (p = kt->pcb) == 0 || p->pagetable != pagetable){
+      epoch[h] = 0;
+      continue;
     }
+    ipi(h);
+    n++;
   }
+  __sync_fetch_and_add(&tlb.npage, npage);
+  if(n == 0)
+    return;
+
+  t0 = r_time();
+  for(h = 0; h < NCPU; h++)
+    if(epoch[h] % 2)
+      while(__atomic_load_n(&cpus[h].uepoch, __ATOMIC_SEQ_CST) == epoch[h])
+        ;
+  __sync_fetch_and_add(&tlb.nshoot, 1);
+  __sync_fetch_and_add(&tlb.nipi, n);
+  __sync_fetch_and_add(&tlb.cycles, r_time() - t0);
+}
+
+// Fill st[0..3] with the number of TLB shootdowns that
+// sent IPIs, the IPIs sent, the mtime cycles spent waiting
+// for them, and the pages freed after shootdowns.
+void
+tlbstat(uint64 *st)
+{
+  st[0] = tlb.nshoot;
+  st[1] = tlb.nipi;
+  st[2] = tlb.cycles;
+  st[3] = tlb.npage;
 }
 
 // Switch to scheduler.  Must hold only p->p_lock
@@ -556,7 +932,7 @@ yield(void)
 {
   acquire(&mykthread()->t_lock);
   
-  mykthread()->t_state = RUNNABLE;
+  setrunnable(mykthread());
 
   sched();
   
@@ -584,73 +960,232 @@ forkret(void)
   usertrapret();
 }
 
-// Atomically release lock and sleep on chan.
-// Reacquires lock when awakened.
+// Sleeping kthreads wait in a table of queues hashed by chan,
+// so that wakeup() looks only at kthreads sleeping on channels
+// that hash alike instead of locking every kthread of every
+// process. A queue's lock protects its list and the wq and
+// wqnext of the kthreads on it; kt->t_lock must also be held
+// to change kt->wq. Lock order: the sleeper's condition lock,
+// then the queue lock, then kt->t_lock.
+struct waitq {
+  struct spinlock lock;
+  struct kthread *head;    // oldest sleeper first
+};
+
+static struct waitq waitq[NWAITQ];
+
+static struct waitq*
+chanq(void *chan)
+{
+  uint64 h = (uint64)chan;
+
+  h ^= h >> 12;
+  return &waitq[(h >> 3) % NWAITQ];
+}
+
 void
-sleep(void *chan, struct spinlock *lk)
+waitqinit(void)
+{
+  struct waitq *wq;
+
+  for(wq = waitq; wq < &waitq[NWAITQ]; wq++){
+    initlock(&wq->lock, "waitq");
+    wq->head = 0;
+  }
+}
+
+// Atomically release lock and sleep on chan, unless intr
+// is set and the kthread has been killed: then return -1
+// at once, still holding lock.
+// Reacquires lock when awakened.
+static int
+sleepon(void *chan, struct spinlock *lk, int intr)
 {
   struct kthread *kt = mykthread();
-  //struct proc *p = myproc();
+  struct waitq *wq = chanq(chan);
+  struct kthread **pp;
   
-  // Must acquire p->p_lock in order to
-  // change p->p_state and then call sched.
-  // Once we hold p->p_lock, we can be
+  // Must acquire kt->t_lock in order to
+  // change kt->t_state and then call sched.
+  // Once we hold wq->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->p_lock),
+  // (wakeup locks wq->lock),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&kt->t_lock);  //DOC: sleeplock1
+
+  // kthread_kill() and kthread_reapothers() set t_killed
+  // under t_lock, and wake kt only if it is SLEEPING; so
+  // either they see it asleep, or we see the kill here.
+  if(intr && kt->t_killed){
+    release(&kt->t_lock);
+    release(&wq->lock);
+    return -1;
+  }
   release(lk);
 
-  // Go to sleep.
+  // Go to sleep, at the tail of the queue.
   kt->chan = chan;
   kt->t_state = SLEEPING;
+  for(pp = &wq->head; *pp; pp = &(*pp)->wqnext)
+    ;
+  *pp = kt;
+  kt->wqnext = 0;
+  kt->wq = wq;
+  release(&wq->lock);
 
   sched();
 
   // Tidy up.
   kt->chan = 0;
+  wq = kt->wq;
+  release(&kt->t_lock);
+
+  // wakeup() unlinks the kthreads it wakes, but kill() and
+  // kthread_kill() leave them queued. Nobody else unlinks a
+  // kthread that is not SLEEPING, so kt->wq cannot change
+  // under us here.
+  if(wq){
+    acquire(&wq->lock);
+    for(pp = &wq->head; *pp != kt; pp = &(*pp)->wqnext)
+      ;
+    *pp = kt->wqnext;
+    acquire(&kt->t_lock);
+    kt->wq = 0;
+    release(&kt->t_lock);
+    release(&wq->lock);
+  }
 
   // Reacquire original lock.
-  release(&kt->t_lock);
   acquire(lk);
+  return 0;
+}
+
+void
+sleep(void *chan, struct spinlock *lk)
+{
+  sleepon(chan, lk, 0);
+}
+
+// Sleep on chan, for a wait that the kthread's kill should
+// end. Returns -1 without sleeping if it has been killed.
+int
+sleepintr(void *chan, struct spinlock *lk)
+{
+  return sleepon(chan, lk, 1);
+}
+
+// Wake up kthreads of process p, or of any process if p
+// is 0, that sleep on chan: all of them, or only the n that
+// have waited longest if n is set. Returns how many woke.
+// Must be called without any kt->t_lock.
+static int
+wakechan(void *chan, int n, struct proc *p)
+{
+  struct waitq *wq = chanq(chan);
+  struct kthread *kt, **pp;
+  int woken = 0;
+
+  acquire(&wq->lock);
+  pp = &wq->head;
+  while((kt = *pp) != 0){
+    acquire(&kt->t_lock);
+    if(kt->t_state == SLEEPING && kt->chan == chan && (p == 0 || kt->pcb == p)) {
+      *pp = kt->wqnext;
+      kt->wq = 0;
+      setrunnable(kt);
+      release(&kt->t_lock);
+      if(++woken == n)
+        break;
+      continue;
+    }
+    release(&kt->t_lock);
+    pp = &kt->wqnext;
+  }
+  release(&wq->lock);
+  return woken;
 }
 
 // Wake up all Kthreads sleeping on chan.
-// Must be called without any p->p_lock.
+// Must be called without any kt->t_lock.
 void
 wakeup(void *chan) 
 {
-  struct kthread *kt;
-  struct proc *p;
+  wakechan(chan, 0, 0);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->p_lock);
+// Wake up one Kthread sleeping on chan, for callers
+// where every sleeper waits for the same thing and only
+// one of them can use it.
+// Must be called without any kt->t_lock.
+void
+wakeup_one(void *chan)
+{
+  wakechan(chan, 1, 0);
+}
 
-      if(p->p_state == USED){
-        release(&p->p_lock);
+// Futexes: kthreads of a process wait on a word of its
+// memory, and sleep on the word's user address. The lock
+// of the word's bucket orders futex_wait()'s check of the
+// word against futex_wake(), so no wakeup is lost.
+static struct spinlock futexlock[NFUTEX];
 
-        for(kt = p->kthread;kt < &p->kthread[NKT]; kt++){
-        struct kthread *my_kt = mykthread();
-        if(kt != my_kt){
-        acquire(&kt->t_lock);
+void
+futexinit(void)
+{
+  int i;
 
-        if(kt->t_state == SLEEPING) {
-          if(kt->chan == chan){
-            kt->t_state = RUNNABLE;
-          }
-        }
+  for(i = 0; i < NFUTEX; i++)
+    initlock(&futexlock[i], "futex");
+}
 
-        release(&kt->t_lock);
-        }
-      }
+static struct spinlock*
+futexbucket(uint64 addr)
+{
+  return &futexlock[(addr >> 2) % NFUTEX];
+}
 
-      }
+// Sleep on the int at user address addr if it still
+// holds val. Returns 0 when woken, or -1 at once if the
+// word differs, and if the kthread is killed.
+int
+futex_wait(uint64 addr, int val)
+{
+  struct proc *p = myproc();
+  struct spinlock *lk;
+  int cur;
 
-      else{
-      release(&p->p_lock);
-      }
+  if(addr % sizeof(int))
+    return -1;
+  lk = futexbucket(addr);
+  acquire(lk);
+  if(copyin(p->pagetable, (char *)&cur, addr, sizeof(cur)) < 0 || cur != val ||
+     ktkilled() || sleepintr((void *)addr, lk) < 0){
+    release(lk);
+    return -1;
   }
+  release(lk);
+  if(ktkilled())
+    return -1;
+  return 0;
+}
+
+// Wake at most n kthreads (all if n <= 0) waiting on the
+// int at user address addr. Returns how many woke.
+int
+futex_wake(uint64 addr, int n)
+{
+  struct spinlock *lk;
+  int woken;
+
+  if(addr % sizeof(int))
+    return -1;
+  lk = futexbucket(addr);
+  acquire(lk);
+  woken = wakechan((void *)addr, n > 0 ? n : 0, myproc());
+  release(lk);
+  return woken;
 }
 
 // Kill the process with the given pid.
@@ -666,13 +1201,13 @@ kill(int pid)
     if(p->pid == pid){
       p->p_killed = 1;
       struct kthread *kt;
-      for(kt = p->kthread; kt < &p->kthread[NKT]; kt++){
+      for(kt = p->kthreads; kt; kt = kt->tnext){
         struct kthread *my_kt = mykthread();
         if(kt != my_kt){
         acquire(&kt->t_lock);
         if(kt->t_state == SLEEPING){
         // Wake Kthread from sleep().
-        kt->t_state = RUNNABLE;
+        setrunnable(kt);
         }
         release(&kt->t_lock);
         }else{
@@ -706,6 +1241,16 @@ killed(struct proc *p)
   return k;
 }
 
+// Whether the calling kthread should give up an
+// interruptible sleep: its process has been killed, or
+// it has itself, by kthread_kill() or by a sibling's
+// exit() or exec() in kthread_reapothers().
+int
+ktkilled(void)
+{
+  return killed(myproc()) || mykthread()->t_killed;
+}
+
 // int
 // killedThread(struct kthread *kt)
 // {
@@ -780,19 +1325,23 @@ procdump(void)
 int
 kthread_create( uint64 start_func, uint64 stack, uint stack_size ){
   struct proc *p = myproc();
+  acquire(&p->p_lock);
   struct kthread *kt = allocKthread(p);
+  release(&p->p_lock);
   if(kt){
   struct kthread *my_kt = mykthread();
   *(kt->trapframe) =*(my_kt->trapframe);
 
-  kt->t_state = RUNNABLE;
-
   kt->trapframe->sp = stack + stack_size;
   kt->trapframe->epc = start_func;
+  kt->affinity = my_kt->affinity;
+
+  setrunnable(kt);
   
+  int tid = kt->tid;
   release(&kt->t_lock);
   
-  return kt->tid; 
+  return tid; 
   }
   
   return -1;
@@ -805,105 +1354,182 @@ int kthread_id(){
 int kthread_kill(int ktid){ 
   struct proc *p = myproc();
   struct kthread *kt;
-  for(kt = p->kthread; kt < &p->kthread[NKT]; kt++){
+  acquire(&p->p_lock);
+  for(kt = p->kthreads; kt; kt = kt->tnext){
     acquire(&kt->t_lock);
     if(kt->tid == ktid){
       if(kt->t_state == SLEEPING){
-        kt->t_state = RUNNABLE;
+        setrunnable(kt);
       }
       kt->t_killed = 1;
       release(&kt->t_lock);
+      release(&p->p_lock);
       return 0;
     }
     release(&kt->t_lock);
   }
+  release(&p->p_lock);
   return -1;
 }
 
+// Let kthread ktid of this process run only on the harts
+// in mask, or on any hart if mask is 0. A kthread moved off
+// the hart it runs on moves at once if it is the caller, or
+// else when it next gives up its hart. Returns -1 if there
+// is no such kthread or no hart in mask has started.
+int
+kthread_setaffinity(int ktid, int mask)
+{
+  struct proc *p = myproc();
+  struct kthread *kt;
+  int move = 0;
+
+  mask &= ALLHARTS;
+  if(mask == 0)
+    mask = ALLHARTS;
+  if((mask & onlineharts) == 0)
+    return -1;
+  acquire(&p->p_lock);
+  for(kt = p->kthreads; kt; kt = kt->tnext){
+    if(kt->tid == ktid){
+      acquire(&kt->t_lock);
+      kt->affinity = mask;
+      move = kt == mykthread() && (mask & (1 << kt->cpu)) == 0;
+      release(&kt->t_lock);
+      break;
+    }
+  }
+  release(&p->p_lock);
+  if(kt == 0)
+    return -1;
+  if(move)
+    yield();
+  return 0;
+}
+
+// Turn gang scheduling of this process's kthreads on
+// or off. Returns whether it was on.
+int
+kthread_gang(int on)
+{
+  struct proc *p = myproc();
+  int old;
+
+  acquire(&p->p_lock);
+  old = p->gang;
+  p->gang = on != 0;
+  release(&p->p_lock);
+  return old;
+}
+
 void
 kthread_exit(int status){ 
-  //struct kthread *kt = mykthread();
+  struct proc *p = myproc();
+  struct kthread *kt = mykthread();
   struct kthread *k;
   int num_of_rel_thrds = 0;
   
-  acquire(&myproc()->p_lock);
+  acquire(&p->p_lock);
 
-  for(k = myproc()->kthread; k <&myproc()->kthread[NKT];k++){
+  for(k = p->kthreads; k; k = k->tnext){
     acquire(&k->t_lock);
-    if(k->t_state == Kthread_UNUSED){
-      release(&k->t_lock);
-      continue;
-    }
-
-    if(k->t_state == Kthread_ZOMBIE){
-      release(&k->t_lock);
-      continue;
-    }
-    
-    num_of_rel_thrds += 1;
+    if(k->t_state != Kthread_ZOMBIE)
+      num_of_rel_thrds += 1;
     release(&k->t_lock);
   }
 
-  release(&myproc()->p_lock);
+  if(num_of_rel_thrds == 1){
+    release(&p->p_lock);
+    exit(status);
+  }
 
-  if(num_of_rel_thrds != 1){
-    acquire(&mykthread()->t_lock);
+  // joiners sleep on kt with p->p_lock held, so this wakeup
+  // is not lost; and kt->t_lock, which the scheduler holds
+  // until it has switched away, keeps them from freeing
+  // kt's stack under it.
+  wakeup(kt);
 
-    mykthread()->t_state = Kthread_ZOMBIE;
-    mykthread()->t_xstate = status;
-    
-    release(&mykthread()->t_lock);
+  acquire(&kt->t_lock);
+  kt->t_state = Kthread_ZOMBIE;
+  kt->t_xstate = status;
+  release(&p->p_lock);
 
-    wakeup(mykthread());
-    
-    acquire(&mykthread()->t_lock);
-    
-    sched();
-  }
-  else{
-    exit(status);
-  }
+  sched();
+  panic("zombie kthread exit");
 }
 
 int
 kthread_join(int ktid, uint64 status){
   struct kthread *kt;
-  struct kthread *tt = 0;
   struct proc *p = myproc();
   
   acquire(&p->p_lock);
   for(;;){
-    int counter = 0;
-    for(kt = p->kthread; kt < &p->kthread[NKT]; kt++){
-      acquire(&kt->t_lock);
-      if(kt->tid == ktid){
-        if(kt->t_state != Kthread_UNUSED){
-        counter = 1;
-        tt = kt;
-        if(kt->t_state == Kthread_ZOMBIE){
-          if(status != 0 && copyout(p->pagetable, status, (char *)&kt->t_xstate,
-                                  sizeof(kt->t_xstate)) < 0) {
-            release(&kt->t_lock);
-            release(&p->p_lock);
-            return -1;
-          }
-          freeKthread(kt);
-          release(&kt->t_lock);
-          release(&p->p_lock);
-          return 0;
-        }
-      }
+    for(kt = p->kthreads; kt && kt->tid != ktid; kt = kt->tnext)
+      ;
+    if(kt == 0){
+      release(&p->p_lock);
+      return -1;
+    }
+
+    acquire(&kt->t_lock);
+    if(kt->t_state == Kthread_ZOMBIE){
+      if(status != 0 && copyout(p->pagetable, status, (char *)&kt->t_xstate,
+                              sizeof(kt->t_xstate)) < 0) {
+        release(&kt->t_lock);
+        release(&p->p_lock);
+        return -1;
       }
+      freeKthread(kt);
       release(&kt->t_lock);
+      release(&p->p_lock);
+      return 0;
     }
+    release(&kt->t_lock);
 
-    struct kthread *my_kt = mykthread();
-
-    if(!counter || my_kt->t_killed == 1){
+    if(mykthread()->t_killed == 1){
       release(&p->p_lock);
       return -1;
     }
 
-    sleep(tt, &p->p_lock);  
+    sleep(kt, &p->p_lock);  
   }
-}
\ No newline at end of file
+}
+
+// Kill the calling kthread's siblings and wait for them
+// to exit, for exit() and exec(). If a sibling does the
+// same at once, the one killed first exits.
+void
+kthread_reapothers(void)
+{
+  struct proc *p = myproc();
+  struct kthread *me = mykthread();
+  struct kthread *kt;
+
+  acquire(&p->p_lock);
+  for(;;){
+    for(kt = p->kthreads; kt == me; kt = kt->tnext)
+      ;
+    if(kt == 0)
+      break;
+
+    if(me->t_killed){
+      release(&p->p_lock);
+      kthread_exit(-1);
+    }
+
+    acquire(&kt->t_lock);
+    if(kt->t_state == Kthread_ZOMBIE){
+      freeKthread(kt);
+      release(&kt->t_lock);
+      continue;
+    }
+    kt->t_killed = 1;
+    if(kt->t_state == SLEEPING)
+      setrunnable(kt);
+    release(&kt->t_lock);
+
+    sleep(kt, &p->p_lock);
+  }
+  release(&p->p_lock);
+}
@@ -13,9 +13,12 @@ struct proc {
   int p_killed;                  // If non-zero, have been killed
   int p_xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int gang;                    // Schedule the kthreads together
 
-  struct kthread kthread[NKT];        // kthread group table
-  struct trapframe *base_trapframes;  // data page for trampolines
+  struct kthread *kthreads;           // kthread group, linked by tnext
+  int nkthread;                       // length of that list
+  char tfused[NKT];                   // trapframe slots in use
+  struct trapframe *tfpages[NTFPAGE]; // trapframe pages, or 0
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -27,4 +30,5 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  void (*kmain)(void);         // Body of a kproc(), else 0
 };
@@ -40,6 +40,23 @@ releasesleep(struct sleeplock *lk)
   release(&lk->lk);
 }
 
+// Acquire lk if no one holds it, without sleeping.
+// Return 1 if it was acquired, else 0.
+int
+tryacquiresleep(struct sleeplock *lk)
+{
+  int r = 0;
+
+  acquire(&lk->lk);
+  if(!lk->locked){
+    lk->locked = 1;
+    lk->pid = myproc()->pid;
+    r = 1;
+  }
+  release(&lk->lk);
+  return r;
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
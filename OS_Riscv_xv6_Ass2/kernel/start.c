@@ -11,9 +11,10 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][6];
 
-// assembly code in kernelvec.S for machine-mode timer interrupt.
+// assembly code in kernelvec.S for machine-mode timer
+// and software interrupts.
 extern void timervec();
 
 // entry.S jumps here in machine mode on stack0.
@@ -73,6 +74,7 @@ timerinit()
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
   // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[5] : set by each timer interrupt, cleared by devintr().
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
   scratch[4] = interval;
@@ -84,6 +86,10 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer interrupts, and software
+  // interrupts, which other harts send with ipi().
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
+
+  // let supervisor mode read the time CSR.
+  w_mcounteren(r_mcounteren() | 2);
 }
@@ -106,6 +106,18 @@ extern uint64 sys_kthread_id(void);
 extern uint64 sys_kthread_kill(void);
 extern uint64 sys_kthread_exit(void);
 extern uint64 sys_kthread_join(void);
+extern uint64 sys_bcachestat(void);
+extern uint64 sys_diskstat(void);
+extern uint64 sys_dropcache(void);
+extern uint64 sys_fsync(void);
+extern uint64 sys_logstat(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_freemem(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_kthread_setaffinity(void);
+extern uint64 sys_kthread_gang(void);
+extern uint64 sys_tlbstat(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -136,6 +148,18 @@ static uint64 (*syscalls[])(void) = {
 [SYS_kthread_kill] sys_kthread_kill,
 [SYS_kthread_exit] sys_kthread_exit,
 [SYS_kthread_join] sys_kthread_join,
+[SYS_bcachestat] sys_bcachestat,
+[SYS_diskstat] sys_diskstat,
+[SYS_dropcache] sys_dropcache,
+[SYS_fsync]   sys_fsync,
+[SYS_logstat] sys_logstat,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_freemem] sys_freemem,
+[SYS_schedstat] sys_schedstat,
+[SYS_kthread_setaffinity] sys_kthread_setaffinity,
+[SYS_kthread_gang] sys_kthread_gang,
+[SYS_tlbstat] sys_tlbstat,
 };
 
 void
@@ -24,4 +24,16 @@
 #define SYS_kthread_id 23
 #define SYS_kthread_kill 24
 #define SYS_kthread_exit 25
-#define SYS_kthread_join 26
\ No newline at end of file
+#define SYS_kthread_join 26
+#define SYS_bcachestat 27
+#define SYS_diskstat 28
+#define SYS_dropcache 29
+#define SYS_fsync 30
+#define SYS_logstat 31
+#define SYS_futex_wait 32
+#define SYS_futex_wake 33
+#define SYS_freemem 34
+#define SYS_schedstat 35
+#define SYS_kthread_setaffinity 36
+#define SYS_kthread_gang 37
+#define SYS_tlbstat 38
\ No newline at end of file
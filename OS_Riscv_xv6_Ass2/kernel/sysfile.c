@@ -107,6 +107,20 @@ sys_close(void)
   return 0;
 }
 
+// return once everything written to fd, and to any other
+// file, is committed to disk.
+uint64
+sys_fsync(void)
+{
+  int fd;
+  struct file *f;
+
+  if(argfd(0, &fd, &f) < 0)
+    return -1;
+  log_sync();
+  return 0;
+}
+
 uint64
 sys_fstat(void)
 {
@@ -176,10 +190,11 @@ isdirempty(struct inode *dp)
   int off;
   struct dirent de;
 
-  for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
+  // "." and ".." are not first in a hashed directory.
+  for(off=0; off<dp->size; off+=sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("isdirempty: readi");
-    if(de.inum != 0)
+    if(de.inum != 0 && namecmp(de.name, ".") != 0 && namecmp(de.name, "..") != 0)
       return 0;
   }
   return 1;
@@ -189,7 +204,6 @@ uint64
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
   char name[DIRSIZ], path[MAXPATH];
   uint off;
 
@@ -219,9 +233,7 @@ sys_unlink(void)
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  dirunlink(dp, name, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -355,6 +367,9 @@ sys_open(void)
   } else {
     f->type = FD_INODE;
     f->off = 0;
+    f->raoff = 0;
+    f->rawin = 0;
+    f->rablock = 0;
   }
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
@@ -377,7 +392,7 @@ sys_mkdir(void)
   struct inode *ip;
 
   begin_op();
-  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, DIRHASHED, 0)) == 0){
     end_op();
     return -1;
   }
@@ -503,3 +518,53 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// copy the buffer cache's hits, misses, lookup
+// cycles and size to st, an array of 4 uint64s.
+uint64
+sys_bcachestat(void)
+{
+  uint64 st;
+  uint64 buf[4];
+
+  argaddr(0, &st);
+  bstat(buf);
+  return copyout(myproc()->pagetable, st, (char*)buf, sizeof(buf));
+}
+
+// copy the disk's request count, summed queue depth,
+// deepest queue and blocks moved to st, an array of
+// 4 uint64s.
+uint64
+sys_diskstat(void)
+{
+  uint64 st;
+  uint64 buf[4];
+
+  argaddr(0, &st);
+  virtio_disk_stat(buf);
+  return copyout(myproc()->pagetable, st, (char*)buf, sizeof(buf));
+}
+
+// copy the log's FS system call, commit and logged
+// block counts to st, an array of 3 uint64s.
+uint64
+sys_logstat(void)
+{
+  uint64 st;
+  uint64 buf[3];
+
+  argaddr(0, &st);
+  log_stat(buf);
+  return copyout(myproc()->pagetable, st, (char*)buf, sizeof(buf));
+}
+
+// empty the buffer cache of unused blocks, and the dentry
+// cache, so that benchmarks can time reads from the disk.
+uint64
+sys_dropcache(void)
+{
+  bdrop(ROOTDEV);
+  dcpurge(ROOTDEV, 0);
+  return 0;
+}
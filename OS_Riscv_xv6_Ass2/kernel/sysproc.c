@@ -58,11 +58,8 @@ sys_sleep(void)
   acquire(&tickslock);
   ticks0 = ticks;
   while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      struct kthread *kt = mykthread();
-      if(kt->t_killed != 0){
-        kthread_exit(-1);
-      }
+    if(ktkilled()){
+      // usertrap() exits on the way out.
       release(&tickslock);
       return -1;
     }
@@ -117,6 +114,21 @@ sys_kthread_kill(void){
   return kthread_kill(ktid);
 }
 
+uint64
+sys_kthread_setaffinity(void){
+  int ktid, mask;
+  argint(0, &ktid);
+  argint(1, &mask);
+  return kthread_setaffinity(ktid, mask);
+}
+
+uint64
+sys_kthread_gang(void){
+  int on;
+  argint(0, &on);
+  return kthread_gang(on);
+}
+
 uint64
 sys_kthread_exit(void){
   int status;
@@ -133,4 +145,58 @@ sys_kthread_join(void){
   argint(0, &ktid);
   argaddr(1, &status);
   return kthread_join(ktid, (uint64)status);
-}
\ No newline at end of file
+}
+
+uint64
+sys_futex_wait(void){
+  uint64 addr;
+  int val;
+
+  argaddr(0, &addr);
+  argint(1, &val);
+  return futex_wait(addr, val);
+}
+
+uint64
+sys_futex_wake(void){
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return futex_wake(addr, n);
+}
+
+// number of free physical pages, for benchmarks
+// that measure the kernel's memory use.
+uint64
+sys_freemem(void)
+{
+  return kfreepages();
+}
+
+// copy the schedulers' pick count, pick cycles, empty-pass
+// cycles and wfi cycles to st, an array of 4 uint64s.
+uint64
+sys_schedstat(void)
+{
+  uint64 st;
+  uint64 buf[4];
+
+  argaddr(0, &st);
+  schedstat(buf);
+  return copyout(myproc()->pagetable, st, (char*)buf, sizeof(buf));
+}
+
+// copy the TLB shootdown, IPI, wait-cycle and freed-page
+// counts to st, an array of 4 uint64s.
+uint64
+sys_tlbstat(void)
+{
+  uint64 st;
+  uint64 buf[4];
+
+  argaddr(0, &st);
+  tlbstat(buf);
+  return copyout(myproc()->pagetable, st, (char*)buf, sizeof(buf));
+}
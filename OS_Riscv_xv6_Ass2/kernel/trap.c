@@ -16,6 +16,9 @@ void kernelvec();
 
 extern int devintr();
 
+// in start.c; timervec sets [5] when a timer interrupt is due.
+extern uint64 timer_scratch[NCPU][6];
+
 void
 trapinit(void)
 {
@@ -45,6 +48,9 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  // uservec has flushed the TLB; tell tlbshootdown().
+  __sync_fetch_and_add(&mycpu()->uepoch, 1);
+
   struct proc *p = myproc();
   struct kthread *kt = mykthread();
   // save user program counter.
@@ -53,15 +59,10 @@ usertrap(void)
   if(r_scause() == 8){
     // system call
 
-    if(killed(p)){
-      struct kthread *kt = mykthread();
-      acquire(&kt->t_lock);
-      if(kt->t_killed != 0){
-        kthread_exit(-1);
-      }
-      release(&kt->t_lock);
+    if(kt->t_killed)
+      kthread_exit(-1);
+    if(killed(p))
       exit(-1);
-    }
 
     // sepc points to the ecall instruction,
     // but we want to return to the next instruction.
@@ -80,13 +81,10 @@ usertrap(void)
     setkilled(p);
   }
 
-  if(killed(p)){
-    struct kthread *kt = mykthread();
-    if(kt->t_killed != 0){
-      kthread_exit(-1);
-    }
+  if(kt->t_killed)
+    kthread_exit(-1);
+  if(killed(p))
     exit(-1);
-  }
 
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2)
@@ -109,6 +107,10 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  // from here on, tlbshootdown() waits for this hart. the
+  // atomic add orders it before userret's TLB flush.
+  __sync_fetch_and_add(&mycpu()->uepoch, 1);
+
   // send syscalls, interrupts, and exceptions to uservec in trampoline.S
   uint64 trampoline_uservec = TRAMPOLINE + (uservec - trampoline);
   w_stvec(trampoline_uservec);
@@ -139,7 +141,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64, uint64))trampoline_userret)(TRAPFRAME((uint)(kt - p->kthread)), satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(TRAPFRAME(kt->tfidx), satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -183,15 +185,23 @@ clockintr()
   release(&tickslock);
 }
 
+// interrupt hart, to end its wfi in scheduler().
+void
+ipi(int hart)
+{
+  *(uint32*)CLINT_MSIP(hart) = 1;
+}
+
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if timer interrupt or an IPI asking to reschedule,
+// 1 if other device or another IPI,
 // 0 if not recognized.
 int
 devintr()
 {
   uint64 scause = r_scause();
+  int tick, resched;
 
   if((scause & 0x8000000000000000L) &&
      (scause & 0xff) == 9){
@@ -216,18 +226,23 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or an IPI, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    // an IPI ends a wfi in scheduler(), and makes the
+    // current kthread yield if resched was set with it.
+    tick = __sync_lock_test_and_set(&timer_scratch[cpuid()][5], 0);
+    resched = __sync_lock_test_and_set(&mycpu()->resched, 0);
+
+    if(tick && cpuid() == 0){
+      clockintr();
+    }
+
+    return tick || resched ? 2 : 1;
   } else {
     return 0;
   }
@@ -45,9 +45,11 @@
 #define VIRTIO_RING_F_INDIRECT_DESC 28
 #define VIRTIO_RING_F_EVENT_IDX     29
 
-// this many virtio descriptors.
-// must be a power of two.
-#define NUM 8
+// this many virtio descriptors, three per request.
+// must be a power of two, no more than qemu's queue
+// size (128 in older versions), and each ring must
+// fit in a page.
+#define NUM 128
 
 // a single descriptor, from the spec.
 struct virtq_desc {
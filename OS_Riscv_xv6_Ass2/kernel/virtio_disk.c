@@ -53,6 +53,17 @@ static struct disk {
   // disk command headers.
   // one-for-one with descriptors, for convenience.
   struct virtio_blk_req ops[NUM];
+
+  // requests waiting for descriptors, in order,
+  // chained through b->qnext.
+  struct buf *qhead;
+  struct buf *qtail;
+
+  int inflight;    // requests the device holds.
+  uint64 nreq;     // statistics for virtio_disk_stat().
+  uint64 nblocks;  // blocks moved by the nreq requests.
+  uint64 depthsum; // sum of inflight as each request starts.
+  uint64 maxdepth;
   
   struct spinlock vdisk_lock;
   
@@ -178,7 +189,6 @@ free_desc(int i)
   disk.desc[i].flags = 0;
   disk.desc[i].next = 0;
   disk.free[i] = 1;
-  wakeup(&disk.free[0]);
 }
 
 // free a chain of descriptors.
@@ -196,12 +206,11 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+allocn_desc(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -212,32 +221,37 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// hand b, and the run of buffers for the blocks after
+// it chained through b->rnext, to the device as one
+// request, if enough descriptors are free.
+// caller must hold vdisk_lock.
+static int
+start(struct buf *b)
 {
   uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
+  struct buf *x;
+  int i, n;
 
   // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
-
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
-  }
-
-  // format the three descriptors.
+  // one descriptor for type/reserved/sector, one for each
+  // piece of data, and one for a 1-byte status result.
+  n = 0;
+  for(x = b; x; x = x->rnext)
+    n++;
+  if(n > MAXRUN)
+    panic("virtio_disk run");
+
+  // allocate the descriptors.
+  int idx[MAXRUN + 2];
+  if(allocn_desc(idx, n + 2) != 0)
+    return -1;
+
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
   struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
 
-  if(write)
+  if(b->qwrite)
     buf0->type = VIRTIO_BLK_T_OUT; // write the disk
   else
     buf0->type = VIRTIO_BLK_T_IN; // read the disk
@@ -249,23 +263,24 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  for(x = b, i = 1; x; x = x->rnext, i++){
+    disk.desc[idx[i]].addr = (uint64) x->data;
+    disk.desc[idx[i]].len = BSIZE;
+    if(b->qwrite)
+      disk.desc[idx[i]].flags = 0; // device reads x->data
+    else
+      disk.desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes x->data
+    disk.desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    disk.desc[idx[i]].next = idx[i+1];
+  }
 
   disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  disk.desc[idx[n+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[n+1]].len = 1;
+  disk.desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[n+1]].next = 0;
 
   // record struct buf for virtio_disk_intr().
-  b->disk = 1;
   disk.info[idx[0]].b = b;
 
   // tell the device the first index in our chain of descriptors.
@@ -280,20 +295,65 @@ virtio_disk_rw(struct buf *b, int write)
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
+  disk.inflight++;
+  disk.nreq++;
+  disk.nblocks += n;
+  disk.depthsum += disk.inflight;
+  if(disk.inflight > disk.maxdepth)
+    disk.maxdepth = disk.inflight;
+  return 0;
+}
+
+// start reading or writing b and return without waiting.
+// b->rnext may chain up to MAXRUN-1 more buffers for the
+// blocks that follow b's, which go in the same request.
+// when the device is done, virtio_disk_intr() clears
+// each buffer's disk flag and rnext and calls done() on
+// it, with no locks held; if done is 0 it wakes up
+// sleepers on the buffer instead. if the descriptors
+// are busy, the request waits its turn in disk.qhead.
+void
+virtio_disk_submit(struct buf *b, int write, void (*done)(struct buf *))
+{
+  struct buf *x;
+
+  acquire(&disk.vdisk_lock);
+
+  for(x = b; x; x = x->rnext){
+    x->disk = 1;
+    x->done = done;
+  }
+  b->qwrite = write;
+  b->qnext = 0;
+  if(disk.qhead || start(b) < 0){
+    if(disk.qtail)
+      disk.qtail->qnext = b;
+    else
+      disk.qhead = b;
+    disk.qtail = b;
+  }
+
+  release(&disk.vdisk_lock);
+}
+
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  virtio_disk_submit(b, write, 0);
+
   // Wait for virtio_disk_intr() to say request has finished.
+  acquire(&disk.vdisk_lock);
   while(b->disk == 1) {
     sleep(b, &disk.vdisk_lock);
   }
-
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
-
   release(&disk.vdisk_lock);
 }
 
 void
 virtio_disk_intr()
 {
+  struct buf *b, *done = 0;
+
   acquire(&disk.vdisk_lock);
 
   // the device won't raise another interrupt until we tell it
@@ -316,12 +376,54 @@ virtio_disk_intr()
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
 
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    b = disk.info[id].b;
+    disk.info[id].b = 0;
+    free_chain(id);
+    disk.inflight--;
+
+    while(b){
+      struct buf *x = b;
+      b = x->rnext;
+      x->rnext = 0;
+      x->disk = 0;   // disk is done with buf
+      if(x->done){
+        // x is the callback's now; no one else touches it.
+        x->qnext = done;
+        done = x;
+      } else {
+        wakeup(x);
+      }
+    }
 
     disk.used_idx += 1;
   }
 
+  // the freed descriptors go to queued requests.
+  while((b = disk.qhead) != 0 && start(b) == 0){
+    disk.qhead = b->qnext;
+    if(disk.qhead == 0)
+      disk.qtail = 0;
+  }
+
+  release(&disk.vdisk_lock);
+
+  // callbacks may take the locks of the buffer cache.
+  while((b = done) != 0){
+    done = b->qnext;
+    b->done(b);
+  }
+}
+
+// fill st[0..3] with the number of requests, the sum of
+// the requests in flight as each started, the most that
+// were ever in flight at once, and the blocks moved.
+void
+virtio_disk_stat(uint64 *st)
+{
+  acquire(&disk.vdisk_lock);
+  st[0] = disk.nreq;
+  st[1] = disk.depthsum;
+  st[2] = disk.maxdepth;
+  st[3] = disk.nblocks;
   release(&disk.vdisk_lock);
 }
@@ -30,6 +30,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, so that ipi() can write MSIP.
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
@@ -43,9 +46,6 @@ kvmmake(void)
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // allocate and map a kernel stack for each process.
-  proc_mapstacks(kpgtbl);
-  
   return kpgtbl;
 }
 
@@ -164,14 +164,29 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// Free pages that were mapped in pagetable, once no
+// hart can still reach them through its TLB.
+static void
+freebatch(pagetable_t pagetable, uint64 *pa, int n)
+{
+  int i;
+
+  tlbshootdown(pagetable, n);
+  for(i = 0; i < n; i++)
+    kfree((void*)pa[i]);
+}
+
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
-// Optionally free the physical memory.
+// Optionally free the physical memory, TLBBATCH pages
+// at a time, each batch after one TLB shootdown.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
   uint64 a;
   pte_t *pte;
+  uint64 batch[TLBBATCH];
+  int n = 0;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
@@ -183,12 +198,16 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
-    if(do_free){
-      uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
-    }
+    if(do_free)
+      batch[n++] = PTE2PA(*pte);
     *pte = 0;
+    if(n == TLBBATCH){
+      freebatch(pagetable, batch, n);
+      n = 0;
+    }
   }
+  if(n > 0)
+    freebatch(pagetable, batch, n);
 }
 
 // create an empty user page table.
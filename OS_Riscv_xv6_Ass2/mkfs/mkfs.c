@@ -15,14 +15,14 @@
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
 
-#define NINODES 200
+#define NINODES 6000
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int nlog = 2*(LOGSIZE+1);  // two halves; see log.c
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -32,6 +32,12 @@ char zeroes[BSIZE];
 uint freeinode = 1;
 uint freeblock;
 
+// The root directory, built in memory as kernel/fs.c's
+// hlink() would build it.
+#define NROOTBLK 16
+uchar rootdir[NROOTBLK][BSIZE];
+uint nrootblk = 1;
+
 
 void balloc(int);
 void wsect(uint, void*);
@@ -40,6 +46,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void rootlink(char *name, uint inum);
 void die(const char *);
 
 // convert to riscv byte order
@@ -69,8 +76,7 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  uint rootino, inum;
   char buf[BSIZE];
   struct dinode din;
 
@@ -117,15 +123,8 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  rootlink(".", rootino);
+  rootlink("..", rootino);
 
   for(i = 2; i < argc; i++){
     // get rid of "user/"
@@ -149,10 +148,7 @@ main(int argc, char *argv[])
 
     inum = ialloc(T_FILE);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, shortname, DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    rootlink(shortname, inum);
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -160,11 +156,10 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
+  // write the root, a hashed directory.
+  iappend(rootino, rootdir, nrootblk * BSIZE);
   rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
+  din.major = xshort(DIRHASHED);
   winode(rootino, &din);
 
   balloc(freeblock);
@@ -253,7 +248,7 @@ void
 iappend(uint inum, void *xp, int n)
 {
   char *p = (char*)xp;
-  uint fbn, off, n1;
+  uint fbn, dbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
   uint indirect[NINDIRECT];
@@ -270,7 +265,7 @@ iappend(uint inum, void *xp, int n)
         din.addrs[fbn] = xint(freeblock++);
       }
       x = xint(din.addrs[fbn]);
-    } else {
+    } else if(fbn < NDIRECT + NINDIRECT){
       if(xint(din.addrs[NDIRECT]) == 0){
         din.addrs[NDIRECT] = xint(freeblock++);
       }
@@ -280,6 +275,23 @@ iappend(uint inum, void *xp, int n)
         wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
       }
       x = xint(indirect[fbn-NDIRECT]);
+    } else {
+      dbn = fbn - NDIRECT - NINDIRECT;
+      if(xint(din.addrs[NDIRECT+1]) == 0){
+        din.addrs[NDIRECT+1] = xint(freeblock++);
+      }
+      rsect(xint(din.addrs[NDIRECT+1]), (char*)indirect);
+      if(indirect[dbn / NINDIRECT] == 0){
+        indirect[dbn / NINDIRECT] = xint(freeblock++);
+        wsect(xint(din.addrs[NDIRECT+1]), (char*)indirect);
+      }
+      x = xint(indirect[dbn / NINDIRECT]);
+      rsect(x, (char*)indirect);
+      if(indirect[dbn % NINDIRECT] == 0){
+        indirect[dbn % NINDIRECT] = xint(freeblock++);
+        wsect(x, (char*)indirect);
+      }
+      x = xint(indirect[dbn % NINDIRECT]);
     }
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
@@ -299,3 +311,67 @@ die(const char *s)
   perror(s);
   exit(1);
 }
+
+// FNV-1a hash of a path element, as in kernel/fs.c.
+uint
+namehash(const char *name)
+{
+  uint h = 2166136261;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+// Link of root block bn to the next block of its chain.
+ushort*
+rootnext(uint bn)
+{
+  return &((struct dirslot*)rootdir[bn])[DPB-1].next[0];
+}
+
+// Index of a free dirent in root block bn, or DPB-1.
+uint
+rootfree(uint bn)
+{
+  struct dirent *de = (struct dirent*)rootdir[bn];
+  uint i;
+
+  for(i = 0; i < DPB-1; i++)
+    if(de[i].inum == 0)
+      break;
+  return i;
+}
+
+void
+rootlink(char *name, uint inum)
+{
+  struct dirslot *hs = (struct dirslot*)rootdir[0];
+  struct dirent *de;
+  ushort *head;
+  uint b, bn, i;
+
+  b = namehash(name) % NDIRBUCKET;
+  head = &hs[1 + b/NSLOTNEXT].next[b%NSLOTNEXT];
+  for(bn = xshort(*head); bn != 0; bn = xshort(*rootnext(bn)))
+    if((i = rootfree(bn)) < DPB-1)
+      goto found;
+
+  bn = nrootblk - 1;
+  if(*head == 0 && bn > 0 && *rootnext(bn) == 0 && (i = rootfree(bn)) < DPB-1){
+    *head = xshort(bn);
+    goto found;
+  }
+
+  assert(nrootblk < NROOTBLK);
+  bn = nrootblk++;
+  *rootnext(bn) = *head;
+  *head = xshort(bn);
+  i = 0;
+
+found:
+  de = (struct dirent*)rootdir[bn] + i;
+  de->inum = xshort(inum);
+  strncpy(de->name, name, DIRSIZ);
+}
@@ -0,0 +1,81 @@
+// Parallel stressfs: several processes each write a file and
+// read it back a few times, then report the buffer cache's hit
+// rate and the average time bget() took per lookup.
+//
+// usage: bcachebench [procs] [blocks] [passes]
+
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+char data[BSIZE];
+
+void
+worker(int i, int blocks, int passes)
+{
+  char path[] = "bcache0";
+  int fd, b, pass;
+
+  path[6] += i;
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    printf("bcachebench: create %s failed\n", path);
+    exit(1);
+  }
+  for(b = 0; b < blocks; b++)
+    write(fd, data, sizeof(data));
+  close(fd);
+
+  for(pass = 0; pass < passes; pass++){
+    fd = open(path, O_RDONLY);
+    for(b = 0; b < blocks; b++)
+      read(fd, data, sizeof(data));
+    close(fd);
+  }
+  unlink(path);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 st0[4], st1[4], hit, miss;
+  int procs = 4, blocks = 100, passes = 4;
+  int i, t0, t1;
+
+  if(argc > 1)
+    procs = atoi(argv[1]);
+  if(argc > 2)
+    blocks = atoi(argv[2]);
+  if(argc > 3)
+    passes = atoi(argv[3]);
+  if(procs > 10)
+    procs = 10;
+
+  memset(data, 'a', sizeof(data));
+  bcachestat(st0);
+  t0 = uptime();
+  for(i = 0; i < procs; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("bcachebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      worker(i, blocks, passes);
+  }
+  for(i = 0; i < procs; i++)
+    wait(0);
+  t1 = uptime();
+  bcachestat(st1);
+
+  hit = st1[0] - st0[0];
+  miss = st1[1] - st0[1];
+  printf("%d procs x %d blocks x %d passes: %d ticks, %d buffers\n",
+         procs, blocks, passes, t1 - t0, (int)st1[3]);
+  if(hit + miss)
+    printf("%d lookups, %d%% hits, %d ns per lookup\n", (int)(hit + miss),
+           (int)(hit * 100 / (hit + miss)),
+           (int)((st1[2] - st0[2]) * 100 / (hit + miss)));
+  exit(0);
+}
@@ -0,0 +1,96 @@
+// Small-file creates from several writers at once; each
+// writer fsync()s once, after its last file. Reports creates
+// per second and how many FS system calls and log blocks
+// each group commit carried.
+//
+// usage: commitbench [writers] [files]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+char data[100];
+
+void
+name(char *path, int w, int i)
+{
+  path[0] = 'c';
+  path[1] = 'a' + w;
+  path[2] = '0' + i / 100 % 10;
+  path[3] = '0' + i / 10 % 10;
+  path[4] = '0' + i % 10;
+  path[5] = 0;
+}
+
+void
+writer(int w, int files)
+{
+  char path[6];
+  int i, fd;
+
+  for(i = 0; i < files; i++){
+    name(path, w, i);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      printf("commitbench: create %s failed\n", path);
+      exit(1);
+    }
+    write(fd, data, sizeof(data));
+    if(i == files - 1)
+      fsync(fd);
+    close(fd);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 st0[3], st1[3], ops, commits;
+  char path[6];
+  int writers = 4, files = 30;
+  int w, i, t0, t1;
+
+  if(argc > 1)
+    writers = atoi(argv[1]);
+  if(argc > 2)
+    files = atoi(argv[2]);
+  if(writers > 26)
+    writers = 26;
+  if(files > 1000)
+    files = 1000;
+
+  memset(data, 'c', sizeof(data));
+  logstat(st0);
+  t0 = uptime();
+  for(w = 0; w < writers; w++){
+    int pid = fork();
+    if(pid < 0){
+      printf("commitbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      writer(w, files);
+  }
+  for(w = 0; w < writers; w++)
+    wait(0);
+  t1 = uptime();
+  logstat(st1);
+
+  ops = st1[0] - st0[0];
+  commits = st1[1] - st0[1];
+  if(t1 == t0)
+    t1 = t0 + 1;
+  printf("%d writers x %d files: %d ticks, %d creates/sec\n", writers, files,
+         t1 - t0, writers * files * 10 / (t1 - t0));
+  if(commits)
+    printf("%d commits, %d ops and %d blocks each\n", (int)commits,
+           (int)(ops / commits), (int)((st1[2] - st0[2]) / commits));
+
+  for(w = 0; w < writers; w++){
+    for(i = 0; i < files; i++){
+      name(path, w, i);
+      unlink(path);
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,106 @@
+// Creates, looks up and unlinks many files in one new
+// directory. Times each fifth of the creates separately: with
+// a hashed directory they should not slow down as it fills.
+// Then times lookups of every name, and of a few hot names
+// that the dentry cache can hold.
+//
+// usage: dirbench [files]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NHOT 100    // hot names
+#define HOTROUNDS 50
+
+void
+name(char *path, int i)
+{
+  strcpy(path, "db/f");
+  path[4] = '0' + i / 1000 % 10;
+  path[5] = '0' + i / 100 % 10;
+  path[6] = '0' + i / 10 % 10;
+  path[7] = '0' + i % 10;
+  path[8] = 0;
+}
+
+void
+report(char *what, int n, int t0)
+{
+  int t = uptime() - t0;
+
+  if(t == 0)
+    t = 1;
+  printf("%s: %d in %d ticks, %d us each\n", what, n, t, t * 100000 / n);
+}
+
+void
+lookup(int i)
+{
+  char path[9];
+  int fd;
+
+  name(path, i);
+  if((fd = open(path, O_RDONLY)) < 0){
+    printf("dirbench: open %s failed\n", path);
+    exit(1);
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[9], what[32];
+  int files = 5000;
+  int i, r, fd, part, t0;
+
+  if(argc > 1)
+    files = atoi(argv[1]);
+  if(files > 5500)    // mkfs makes 6000 inodes
+    files = 5500;
+  if(files < 5)
+    files = 5;
+
+  if(mkdir("db") < 0){
+    printf("dirbench: mkdir db failed\n");
+    exit(1);
+  }
+
+  for(part = 0; part < 5; part++){
+    t0 = uptime();
+    for(i = part * files / 5; i < (part + 1) * files / 5; i++){
+      name(path, i);
+      if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+        printf("dirbench: create %s failed\n", path);
+        exit(1);
+      }
+      close(fd);
+    }
+    strcpy(what, "create  /5");
+    what[7] = '1' + part;
+    report(what, files / 5, t0);
+  }
+
+  t0 = uptime();
+  for(i = 0; i < files; i++)
+    lookup(i);
+  report("lookup all", files, t0);
+
+  t0 = uptime();
+  for(r = 0; r < HOTROUNDS; r++)
+    for(i = 0; i < NHOT && i < files; i++)
+      lookup(i);
+  report("lookup hot", HOTROUNDS * (NHOT < files ? NHOT : files), t0);
+
+  t0 = uptime();
+  for(i = 0; i < files; i++){
+    name(path, i);
+    unlink(path);
+  }
+  report("unlink", files, t0);
+
+  if(unlink("db") < 0)
+    printf("dirbench: db not empty\n");
+  exit(0);
+}
@@ -0,0 +1,150 @@
+// Parallel sum with barriers, while other processes
+// compete for the harts. Each round, every kthread sums
+// its slice of an array, all meet at a barrier, one adds
+// up the slices, and all meet again. Runs once with the
+// default scheduling, once with each kthread pinned to a
+// hart, and once in gang mode, and reports the time per
+// round for each.
+//
+// usage: gangbench [kthreads [hogs [rounds]]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+#include "user/usync.h"
+
+#define N      6144   // ints to sum
+#define STACK  4096
+
+enum { DEFAULT, PINNED, GANG };
+char *modes[] = { "default", "pinned", "gang" };
+
+int mode, nthreads, rounds, nextid;
+int data[N];
+int partial[NCPU];
+int total, bad;
+struct barrier bar;
+char *stacks[NCPU];
+
+void
+body(int id)
+{
+  int r, i, s, lo, hi;
+
+  if(mode == PINNED)
+    kthread_setaffinity(kthread_id(), 1 << id);
+  lo = id * N / nthreads;
+  hi = (id + 1) * N / nthreads;
+  for(r = 0; r < rounds; r++){
+    s = 0;
+    for(i = lo; i < hi; i++)
+      s += data[i];
+    partial[id] = s;
+    barrier_wait(&bar);
+    if(id == 0){
+      s = 0;
+      for(i = 0; i < nthreads; i++)
+        s += partial[i];
+      if(s != total)
+        bad++;
+    }
+    barrier_wait(&bar);
+  }
+}
+
+void
+worker(void)
+{
+  body(__atomic_fetch_add(&nextid, 1, __ATOMIC_SEQ_CST));
+  kthread_exit(0);
+}
+
+// Sum in nthreads kthreads, this one included,
+// and return the ticks it took.
+int
+run(int m)
+{
+  int tids[NCPU];
+  int i, t0;
+
+  mode = m;
+  nextid = 1;
+  bad = 0;
+  barrier_init(&bar, nthreads);
+  kthread_gang(m == GANG);
+
+  t0 = uptime();
+  for(i = 1; i < nthreads; i++){
+    tids[i] = kthread_create((void *(*)())worker, stacks[i], STACK);
+    if(tids[i] <= 0){
+      printf("gangbench: kthread_create failed\n");
+      exit(1);
+    }
+  }
+  body(0);
+  for(i = 1; i < nthreads; i++)
+    kthread_join(tids[i], 0);
+  t0 = uptime() - t0;
+
+  kthread_gang(0);
+  kthread_setaffinity(kthread_id(), 0);
+  if(bad){
+    printf("gangbench: %d bad sums\n", bad);
+    exit(1);
+  }
+  return t0 > 0 ? t0 : 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hogs = 2, pids[NCPU];
+  int i, m, t;
+
+  nthreads = 3;
+  rounds = 2000;
+  if(argc > 1)
+    nthreads = atoi(argv[1]);
+  if(argc > 2)
+    hogs = atoi(argv[2]);
+  if(argc > 3)
+    rounds = atoi(argv[3]);
+  if(nthreads < 1 || nthreads > NCPU)
+    nthreads = 3;
+  if(hogs < 0 || hogs > NCPU)
+    hogs = 2;
+  if(rounds < 1)
+    rounds = 2000;
+
+  total = 0;
+  for(i = 0; i < N; i++){
+    data[i] = i % 7;
+    total += data[i];
+  }
+  for(i = 1; i < nthreads; i++)
+    stacks[i] = malloc(STACK);
+
+  // processes that only want the harts.
+  for(i = 0; i < hogs; i++){
+    if((pids[i] = fork()) < 0){
+      printf("gangbench: fork failed\n");
+      exit(1);
+    }
+    if(pids[i] == 0)
+      for(;;)
+        ;
+  }
+
+  printf("%d kthreads, %d hogs, %d rounds\n", nthreads, hogs, rounds);
+  for(m = DEFAULT; m <= GANG; m++){
+    t = run(m);
+    printf("%s: %d ticks, %d us per round\n", modes[m], t,
+           t * 100000 / rounds);
+  }
+
+  for(i = 0; i < hogs; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  exit(0);
+}
@@ -0,0 +1,128 @@
+// Benchmarks the futex-based mutex, semaphore and barrier
+// with 2 to 10 kthreads in one process: lock throughput on
+// a shared counter, handoff latency around a ring of
+// semaphores, and the cost of a barrier. The uncontended
+// lock is timed first; it never enters the kernel.
+//
+// usage: lockbench [kthreads]   (at most NKT)
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+#include "user/usync.h"
+
+#define SOLO     1000000  // uncontended lock+unlock pairs
+#define LOCKOPS  100000   // contended lock+unlock pairs, shared
+#define HANDOFFS 10000    // semaphore handoffs, shared
+#define BARRIERS 1000     // barrier rounds
+
+enum { THROUGHPUT, RING, BARRIER };
+
+int mode, nthreads, nextid;
+char *stacks[NKT];
+
+struct mutex mu;
+int counter;
+struct sem ring[NKT];
+struct barrier bar;
+
+void
+body(int id)
+{
+  int i;
+
+  switch(mode){
+  case THROUGHPUT:
+    for(i = id; i < LOCKOPS; i += nthreads){
+      mutex_lock(&mu);
+      counter++;
+      mutex_unlock(&mu);
+    }
+    break;
+  case RING:
+    for(i = 0; i < HANDOFFS / nthreads; i++){
+      sem_down(&ring[id]);
+      sem_up(&ring[(id + 1) % nthreads]);
+    }
+    break;
+  case BARRIER:
+    for(i = 0; i < BARRIERS; i++)
+      barrier_wait(&bar);
+    break;
+  }
+}
+
+void
+worker(void)
+{
+  body(__atomic_fetch_add(&nextid, 1, __ATOMIC_SEQ_CST));
+  kthread_exit(0);
+}
+
+// Run body() in n kthreads, this one included,
+// and return the ticks it took.
+int
+run(int m, int n)
+{
+  int tids[NKT];
+  int i, t0;
+
+  mode = m;
+  nthreads = n;
+  nextid = 1;
+  counter = 0;
+  mutex_init(&mu);
+  for(i = 0; i < n; i++)
+    sem_init(&ring[i], i == 0);
+  barrier_init(&bar, n);
+
+  t0 = uptime();
+  for(i = 1; i < n; i++){
+    tids[i] = kthread_create((void *(*)())worker, stacks[i], MAX_STACK_SIZE);
+    if(tids[i] <= 0){
+      printf("lockbench: kthread_create failed\n");
+      exit(1);
+    }
+  }
+  body(0);
+  for(i = 1; i < n; i++)
+    kthread_join(tids[i], 0);
+  t0 = uptime() - t0;
+  return t0 > 0 ? t0 : 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int maxt = 10;
+  int i, n, t, tl, th, tb;
+
+  if(argc > 1)
+    maxt = atoi(argv[1]);
+  if(maxt < 2 || maxt > NKT)
+    maxt = 10;
+  for(i = 1; i < maxt; i++)
+    stacks[i] = malloc(MAX_STACK_SIZE);
+
+  t = uptime();
+  for(i = 0; i < SOLO; i++){
+    mutex_lock(&mu);
+    mutex_unlock(&mu);
+  }
+  t = uptime() - t;  // in 100 ms ticks
+  printf("uncontended lock+unlock: %d ns\n", t * (100000000 / SOLO));
+
+  for(n = 2; n <= maxt; n++){
+    tl = run(THROUGHPUT, n);
+    if(counter != LOCKOPS){
+      printf("lockbench: counter %d, want %d\n", counter, LOCKOPS);
+      exit(1);
+    }
+    th = run(RING, n);
+    tb = run(BARRIER, n);
+    printf("%d kthreads: %d locks/sec, %d us per handoff, %d us per barrier\n",
+           n, LOCKOPS * 10 / tl, th * 100000 / (HANDOFFS / n * n),
+           tb * 100000 / BARRIERS);
+  }
+  exit(0);
+}
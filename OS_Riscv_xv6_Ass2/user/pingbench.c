@@ -0,0 +1,69 @@
+// Wakeup latency benchmark: a parent and child bounce a byte
+// through two pipes while a crowd of idle processes sleeps on
+// another pipe. Each round trip is two wakeups, so the rate
+// shows how much the idle sleepers cost every wakeup().
+//
+// usage: pingbench [rounds [idle]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 10000, idle = 60;
+  int a[2], b[2], q[2], i, n, start, elapsed;
+  char c = 0;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(argc > 2)
+    idle = atoi(argv[2]);
+  if(idle < 0 || idle > NPROC - 4)   // init, sh, us and the partner.
+    idle = NPROC - 4;
+  if(pipe(a) < 0 || pipe(b) < 0 || pipe(q) < 0){
+    printf("pingbench: pipe failed\n");
+    exit(1);
+  }
+
+  // the idle crowd blocks reading q until we close it.
+  for(n = 0; n < idle; n++){
+    int pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0){
+      close(q[1]);
+      read(q[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(q[0]);
+
+  if(fork() == 0){
+    close(q[1]);
+    while(read(a[0], &c, 1) == 1)
+      write(b[1], &c, 1);
+    exit(0);
+  }
+  close(a[0]);
+  close(b[1]);
+
+  start = uptime();
+  for(i = 0; i < rounds; i++){
+    write(a[1], &c, 1);
+    read(b[0], &c, 1);
+  }
+  elapsed = uptime() - start;
+
+  close(a[1]);
+  close(q[1]);
+  while(wait(0) > 0)
+    ;
+
+  if(elapsed < 1)
+    elapsed = 1;
+  printf("%d round trips with %d idle processes in %d ticks: %d round trips/sec\n",
+         rounds, n, elapsed, rounds * 10 / elapsed);
+  exit(0);
+}
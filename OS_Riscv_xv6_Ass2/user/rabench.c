@@ -0,0 +1,78 @@
+// Times cat-style reads of a large file and exec() of a large
+// binary, each from a cold buffer cache, to show what
+// sequential read-ahead saves. Run it on a kernel with and
+// without read-ahead to compare.
+//
+// usage: rabench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define BLOCKS 1024 // a 1 MB file, past the single-indirect blocks
+
+char buf[512];      // cat's buffer size
+
+int
+main(int argc, char *argv[])
+{
+  char *args[] = { "usertests", "-x", 0 };
+  int rounds = 5;
+  int i, fd, t, ticks, size;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+
+  if((fd = open("rabench.tmp", O_CREATE | O_RDWR)) < 0){
+    printf("rabench: create failed\n");
+    exit(1);
+  }
+  memset(buf, 'r', sizeof(buf));
+  for(i = 0; i < BLOCKS * BSIZE / sizeof(buf); i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  ticks = 0;
+  for(i = 0; i < rounds; i++){
+    dropcache();
+    t = uptime();
+    fd = open("rabench.tmp", O_RDONLY);
+    while(read(fd, buf, sizeof(buf)) > 0)
+      ;
+    close(fd);
+    ticks += uptime() - t;
+  }
+  unlink("rabench.tmp");
+  if(ticks == 0)
+    ticks = 1;
+  printf("cat %d KB: %d ticks per pass, %d KB/sec\n", BLOCKS * BSIZE / 1024,
+         ticks / rounds, rounds * BLOCKS * BSIZE / 1024 * 10 / ticks);
+
+  if((fd = open(args[0], O_RDONLY)) < 0){
+    printf("rabench: no %s\n", args[0]);
+    exit(1);
+  }
+  size = 0;
+  while((t = read(fd, buf, sizeof(buf))) > 0)
+    size += t;
+  close(fd);
+
+  ticks = 0;
+  for(i = 0; i < rounds; i++){
+    dropcache();
+    t = uptime();
+    if(fork() == 0){
+      // usertests loads, prints its usage and exits.
+      close(1);
+      close(2);
+      exec(args[0], args);
+      exit(1);
+    }
+    wait(0);
+    ticks += uptime() - t;
+  }
+  printf("exec %s (%d KB): %d us each\n", args[0], size / 1024,
+         ticks * 100000 / rounds);
+  exit(0);
+}
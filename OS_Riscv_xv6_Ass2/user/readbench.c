@@ -0,0 +1,161 @@
+// Parallel reader: several processes read files from a cold
+// buffer cache at once, first sequentially with large read()s,
+// then one block at a time from small files picked at random.
+// Reports throughput and how many disk requests were in flight.
+//
+// usage: readbench [procs] [blocks]
+
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define CHUNK 16    // blocks per sequential read()
+#define NSMALL 16   // one-block files per process
+#define NRAND 64    // random reads per process
+
+char data[CHUNK * BSIZE];
+
+// from FreeBSD; see grind.c.
+int
+do_rand(unsigned long *ctx)
+{
+  long hi, lo, x;
+
+  x = (*ctx % 0x7ffffffe) + 1;
+  hi = x / 127773;
+  lo = x % 127773;
+  x = 16807 * lo - 2836 * hi;
+  if (x < 0)
+    x += 0x7fffffff;
+  x--;
+  *ctx = x;
+  return (x);
+}
+
+void
+name(char *path, int i, int j)
+{
+  path[0] = 'r';
+  path[1] = 'b';
+  path[2] = 'a' + i;
+  path[3] = 'a' + j;
+  path[4] = 0;
+}
+
+void
+create(char *path, int blocks)
+{
+  int fd, b;
+
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    printf("readbench: create %s failed\n", path);
+    exit(1);
+  }
+  for(b = 0; b < blocks; b++)
+    write(fd, data, BSIZE);
+  close(fd);
+}
+
+void
+seqreader(int i)
+{
+  char path[5];
+  int fd;
+
+  name(path, i, 0);
+  fd = open(path, O_RDONLY);
+  while(read(fd, data, sizeof(data)) > 0)
+    ;
+  close(fd);
+  exit(0);
+}
+
+void
+randreader(int i)
+{
+  unsigned long seed = i + 1;
+  char path[5];
+  int fd, r;
+
+  for(r = 0; r < NRAND; r++){
+    name(path, i, 1 + do_rand(&seed) % NSMALL);
+    fd = open(path, O_RDONLY);
+    read(fd, data, BSIZE);
+    close(fd);
+  }
+  exit(0);
+}
+
+// run procs copies of f on a cold cache and
+// report the disk's part in it.
+void
+run(char *what, void (*f)(int), int procs, int kb)
+{
+  uint64 st0[4], st1[4], nreq;
+  int i, t0, t1;
+
+  dropcache();
+  diskstat(st0);
+  t0 = uptime();
+  for(i = 0; i < procs; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("readbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      f(i);
+  }
+  for(i = 0; i < procs; i++)
+    wait(0);
+  t1 = uptime();
+  diskstat(st1);
+
+  nreq = st1[0] - st0[0];
+  if(t1 == t0)
+    t1 = t0 + 1;
+  printf("%s: %d KB in %d ticks, %d KB/sec, %d requests, %d.%d in flight\n",
+         what, kb, t1 - t0, kb * 10 / (t1 - t0), (int)nreq,
+         nreq ? (int)((st1[1] - st0[1]) / nreq) : 0,
+         nreq ? (int)((st1[1] - st0[1]) * 10 / nreq % 10) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 st[4];
+  char path[5];
+  int procs = 4, blocks = 100;
+  int i, j;
+
+  if(argc > 1)
+    procs = atoi(argv[1]);
+  if(argc > 2)
+    blocks = atoi(argv[2]);
+  if(procs > 10)
+    procs = 10;
+
+  memset(data, 'r', sizeof(data));
+  for(i = 0; i < procs; i++){
+    name(path, i, 0);
+    create(path, blocks);
+    for(j = 1; j <= NSMALL; j++){
+      name(path, i, j);
+      create(path, 1);
+    }
+  }
+
+  run("sequential", seqreader, procs, procs * blocks * BSIZE / 1024);
+  run("random", randreader, procs, procs * NRAND * BSIZE / 1024);
+  diskstat(st);
+  printf("at most %d disk requests in flight\n", (int)st[2]);
+
+  for(i = 0; i < procs; i++){
+    for(j = 0; j <= NSMALL; j++){
+      name(path, i, j);
+      unlink(path);
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,94 @@
+// Scheduler cost with many sleeping processes. Forks
+// processes that block on a pipe, then watches the
+// schedulers for a while with nothing runnable, and again
+// with one process spinning. Reports the time a scheduler
+// takes to pick a kthread, and how much of the harts' time
+// went to looking for work versus waiting in wfi.
+//
+// usage: schedbench [sleepers [ticks]]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define CYCLES 1000000   // mtime cycles per tick
+#define NS     100       // ns per mtime cycle
+
+void
+report(char *what, uint64 *st0, uint64 *st1, int t)
+{
+  uint64 picks = st1[0] - st0[0];
+  uint64 pick = st1[1] - st0[1];
+  uint64 spin = st1[2] - st0[2];
+  uint64 idle = st1[3] - st0[3];
+  uint64 elapsed = (uint64)t * CYCLES;
+
+  // spin and idle are summed over harts, so are in
+  // thousandths of a hart's time here.
+  spin = spin * 1000 / elapsed;
+  idle = idle * 1000 / elapsed;
+  printf("%s: %d picks, %d ns per pick; harts looking for work %d.%d%%,"
+         " in wfi %d.%d%% (of one hart)\n", what, (int)picks,
+         picks ? (int)(pick * NS / picks) : 0,
+         (int)(spin / 10), (int)(spin % 10), (int)(idle / 10), (int)(idle % 10));
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 st0[4], st1[4];
+  int sleepers = 63, t = 20;
+  int p[2], n, pid, t0;
+  char c;
+
+  if(argc > 1)
+    sleepers = atoi(argv[1]);
+  if(argc > 2)
+    t = atoi(argv[2]);
+  if(t < 1)
+    t = 20;
+
+  if(pipe(p) < 0){
+    printf("schedbench: pipe failed\n");
+    exit(1);
+  }
+  for(n = 0; n < sleepers; n++){
+    if((pid = fork()) < 0)
+      break;
+    if(pid == 0){
+      close(p[1]);
+      read(p[0], &c, 1);
+      exit(0);
+    }
+  }
+  printf("%d sleeping processes\n", n);
+
+  // nothing runnable: only this process wakes, once.
+  schedstat(st0);
+  t0 = uptime();
+  sleep(t);
+  t0 = uptime() - t0;
+  schedstat(st1);
+  report("0 runnable", st0, st1, t0);
+
+  // one runnable: a child spins while this one sleeps.
+  schedstat(st0);
+  t0 = uptime();
+  if((pid = fork()) < 0){
+    printf("schedbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    while(uptime() - t0 < t)
+      ;
+    exit(0);
+  }
+  wait(0);
+  t0 = uptime() - t0;
+  schedstat(st1);
+  report("1 runnable", st0, st1, t0);
+
+  close(p[1]);
+  while(wait(0) > 0)
+    ;
+  exit(0);
+}
@@ -0,0 +1,92 @@
+// Cost of shrinking memory in a multithreaded process.
+// With 1, 4 and 8 kthreads, all but one spinning in user
+// mode, the remaining one repeatedly grows the process,
+// touches the new pages and shrinks it again. Each shrink
+// needs a TLB shootdown of the harts the spinners run on.
+// Reports the time per grow+shrink and what the shootdowns
+// cost.
+//
+// usage: shootbench [pages [rounds]]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define MAXT   8
+#define STACK  1024
+
+int stop;
+char *stacks[MAXT];
+
+void
+spinner(void)
+{
+  while(__atomic_load_n(&stop, __ATOMIC_SEQ_CST) == 0)
+    ;
+  kthread_exit(0);
+}
+
+void
+run(int n, int pages, int rounds)
+{
+  uint64 st0[4], st1[4], shoots;
+  int tids[MAXT];
+  int i, r, t;
+  char *a;
+
+  stop = 0;
+  for(i = 1; i < n; i++){
+    tids[i] = kthread_create((void *(*)())spinner, stacks[i], STACK);
+    if(tids[i] <= 0){
+      printf("shootbench: kthread_create failed\n");
+      exit(1);
+    }
+  }
+
+  tlbstat(st0);
+  t = uptime();
+  for(r = 0; r < rounds; r++){
+    if((a = sbrk(pages * 4096)) == (char*)-1){
+      printf("shootbench: sbrk failed\n");
+      exit(1);
+    }
+    for(i = 0; i < pages; i++)
+      a[i * 4096] = r;
+    sbrk(-pages * 4096);
+  }
+  t = uptime() - t;
+  tlbstat(st1);
+
+  __atomic_store_n(&stop, 1, __ATOMIC_SEQ_CST);
+  for(i = 1; i < n; i++)
+    kthread_join(tids[i], 0);
+
+  // mtime cycles are 100 ns.
+  shoots = st1[0] - st0[0];
+  printf("%d kthreads: %d us per grow+shrink of %d pages; "
+         "%d shootdowns, %d IPIs, %d us waiting each\n",
+         n, t * 100000 / rounds, pages, (int)shoots, (int)(st1[1] - st0[1]),
+         shoots ? (int)((st1[2] - st0[2]) / 10 / shoots) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pages = 16, rounds = 500;
+  int i;
+
+  if(argc > 1)
+    pages = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(pages < 1)
+    pages = 16;
+  if(rounds < 1)
+    rounds = 500;
+
+  for(i = 1; i < MAXT; i++)
+    stacks[i] = malloc(STACK);
+  run(1, pages, rounds);
+  run(4, pages, rounds);
+  run(8, pages, rounds);
+  exit(0);
+}
@@ -0,0 +1,83 @@
+// Kernel memory footprint of processes and kthreads. First
+// forks single-threaded processes that block on a pipe and
+// reports the free pages each one costs. Then grows one
+// process to as many kthreads as it can get, and reports
+// the pages each kthread costs.
+//
+// usage: threadbench [procs [kthreads]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define STACK 1024   // user stack per kthread; they only wait
+
+int go;
+int tids[NKT];
+
+void
+waiter(void)
+{
+  while(go == 0)
+    futex_wait(&go, 0);
+  kthread_exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int procs = 64, nkt = NKT - 1;
+  int p[2], i, n, free0, free1;
+  char *stacks;
+  char c;
+
+  if(argc > 1)
+    procs = atoi(argv[1]);
+  if(argc > 2)
+    nkt = atoi(argv[2]);
+  if(nkt < 1 || nkt > NKT - 1)
+    nkt = NKT - 1;
+
+  if(pipe(p) < 0){
+    printf("threadbench: pipe failed\n");
+    exit(1);
+  }
+  free0 = freemem();
+  for(n = 0; n < procs; n++){
+    int pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0){
+      close(p[1]);
+      read(p[0], &c, 1);
+      exit(0);
+    }
+  }
+  free1 = freemem();
+  close(p[1]);
+  while(wait(0) > 0)
+    ;
+  close(p[0]);
+  if(n > 0)
+    printf("%d single-threaded processes: %d pages, %d pages each\n",
+           n, free0 - free1, (free0 - free1) / n);
+
+  // malloc() before counting, so that only
+  // the kernel's pages are counted.
+  stacks = malloc(nkt * STACK);
+  free0 = freemem();
+  for(n = 0; n < nkt; n++){
+    tids[n] = kthread_create((void *(*)())waiter, stacks + n * STACK, STACK);
+    if(tids[n] <= 0)
+      break;
+  }
+  free1 = freemem();
+  go = 1;
+  futex_wake(&go, 0);
+  for(i = 0; i < n; i++)
+    kthread_join(tids[i], 0);
+  if(n > 0)
+    printf("%d more kthreads in one process: %d pages, %d.%d pages each\n",
+           n, free0 - free1, (free0 - free1) / n, (free0 - free1) * 10 / n % 10);
+  exit(0);
+}
@@ -27,6 +27,18 @@ int kthread_id(void);
 int kthread_kill(int ktid);
 void kthread_exit(int status);
 int kthread_join(int ktid, int *status);
+int bcachestat(uint64*);
+int diskstat(uint64*);
+int dropcache(void);
+int fsync(int);
+int logstat(uint64*);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
+int freemem(void);
+int schedstat(uint64*);
+int kthread_setaffinity(int ktid, int mask);
+int kthread_gang(int on);
+int tlbstat(uint64*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -0,0 +1,164 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/usync.h"
+
+// Mutex, condition variable, semaphore and barrier for
+// kthreads. Shared words change only by atomic operations;
+// a kthread that must wait sleeps in futex_wait() on one of
+// them, and the kernel rechecks the word before sleeping, so
+// a change made just before the futex_wake() is not lost.
+
+#define SPINS 100   // tries at a held mutex before sleeping
+
+#define load(p)       __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define store(p, v)   __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define add(p, v)     __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define swap(p, v)    __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+
+// Set *p to new if it holds old; return whether it did.
+static int
+cas(int *p, int old, int new)
+{
+  return __atomic_compare_exchange_n(p, &old, new, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+int
+mutex_trylock(struct mutex *m)
+{
+  return cas(&m->state, 0, 1);
+}
+
+// Sleep until m is free, and take it marked as waited for,
+// since other kthreads may still sleep on it.
+static void
+mutex_lock_slow(struct mutex *m)
+{
+  while(swap(&m->state, 2) != 0)
+    futex_wait(&m->state, 2);
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int i;
+
+  if(cas(&m->state, 0, 1))
+    return;
+  // the holder may be about to let go.
+  for(i = 0; i < SPINS; i++){
+    if(load(&m->state) == 0 && cas(&m->state, 0, 1))
+      return;
+  }
+  mutex_lock_slow(m);
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(swap(&m->state, 0) == 2)
+    futex_wake(&m->state, 1);
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+  c->waiters = 0;
+}
+
+// Release m, wait for a signal, and take m again. A signal
+// sent after the seq is read makes futex_wait() return at
+// once. Like any condition variable, it may wake spuriously.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = load(&c->seq);
+
+  add(&c->waiters, 1);
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  add(&c->waiters, -1);
+  mutex_lock_slow(m);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  add(&c->seq, 1);
+  if(load(&c->waiters) > 0)
+    futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  add(&c->seq, 1);
+  if(load(&c->waiters) > 0)
+    futex_wake(&c->seq, 0);
+}
+
+void
+sem_init(struct sem *s, int count)
+{
+  s->count = count;
+  s->waiters = 0;
+}
+
+void
+sem_down(struct sem *s)
+{
+  int v;
+
+  for(;;){
+    v = load(&s->count);
+    if(v > 0){
+      if(cas(&s->count, v, v - 1))
+        return;
+      continue;
+    }
+    add(&s->waiters, 1);
+    futex_wait(&s->count, 0);
+    add(&s->waiters, -1);
+  }
+}
+
+void
+sem_up(struct sem *s)
+{
+  add(&s->count, 1);
+  if(load(&s->waiters) > 0)
+    futex_wake(&s->count, 1);
+}
+
+void
+barrier_init(struct barrier *b, int n)
+{
+  b->n = n;
+  b->arrived = 0;
+  b->gen = 0;
+}
+
+// The last of n kthreads to arrive resets the count for
+// the next round before it releases the others.
+void
+barrier_wait(struct barrier *b)
+{
+  int gen = load(&b->gen);
+
+  if(add(&b->arrived, 1) == b->n){
+    store(&b->arrived, 0);
+    add(&b->gen, 1);
+    if(b->n > 1)
+      futex_wake(&b->gen, 0);
+    return;
+  }
+  while(load(&b->gen) == gen)
+    futex_wait(&b->gen, gen);
+}
@@ -0,0 +1,42 @@
+// Synchronization for the kthreads of a process, built on
+// futex_wait() and futex_wake(). Each operation enters the
+// kernel only when a kthread must sleep or be woken.
+// Zero-filled structures are ready to use, except that
+// a barrier needs barrier_init().
+
+struct mutex {
+  int state;      // 0 free, 1 held, 2 held and maybe waited for
+};
+
+struct cond {
+  int seq;        // bumped by each signal
+  int waiters;
+};
+
+struct sem {
+  int count;
+  int waiters;
+};
+
+struct barrier {
+  int n;          // kthreads that meet at the barrier
+  int arrived;
+  int gen;        // bumped each time all n have arrived
+};
+
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+int mutex_trylock(struct mutex*);
+void mutex_unlock(struct mutex*);
+
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
+
+void sem_init(struct sem*, int);
+void sem_down(struct sem*);
+void sem_up(struct sem*);
+
+void barrier_init(struct barrier*, int);
+void barrier_wait(struct barrier*);
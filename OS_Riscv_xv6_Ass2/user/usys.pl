@@ -41,3 +41,15 @@ entry("kthread_id");
 entry("kthread_kill");
 entry("kthread_exit");
 entry("kthread_join");
+entry("bcachestat");
+entry("diskstat");
+entry("dropcache");
+entry("fsync");
+entry("logstat");
+entry("futex_wait");
+entry("futex_wake");
+entry("freemem");
+entry("schedstat");
+entry("kthread_setaffinity");
+entry("kthread_gang");
+entry("tlbstat");
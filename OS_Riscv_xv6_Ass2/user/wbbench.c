@@ -0,0 +1,105 @@
+// Write-path benchmark: a stressfs-style large file write,
+// a burst of small-file creates, and write+fsync pairs.
+// For each, reports the rate and how many blocks the disk
+// moved per request, which shows how well the write-back
+// cache coalesces adjacent blocks.
+//
+// usage: wbbench [files] [blocks]
+
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NSYNC 20
+
+char data[BSIZE];
+
+void
+name(char *path, int i)
+{
+  path[0] = 'w';
+  path[1] = 'b';
+  path[2] = '0' + i / 100 % 10;
+  path[3] = '0' + i / 10 % 10;
+  path[4] = '0' + i % 10;
+  path[5] = 0;
+}
+
+void
+report(char *what, int n, char *unit, int t0, uint64 *st0)
+{
+  uint64 st1[4], nreq;
+  int t1;
+
+  t1 = uptime();
+  diskstat(st1);
+  nreq = st1[0] - st0[0];
+  if(t1 == t0)
+    t1 = t0 + 1;
+  printf("%s: %d %s in %d ticks, %d/sec, %d disk requests, %d blocks each\n",
+         what, n, unit, t1 - t0, n * 10 / (t1 - t0), (int)nreq,
+         nreq ? (int)((st1[3] - st0[3]) / nreq) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 st0[4];
+  char path[6];
+  int files = 100, blocks = 200;
+  int i, fd, t0;
+
+  if(argc > 1)
+    files = atoi(argv[1]);
+  if(argc > 2)
+    blocks = atoi(argv[2]);
+  if(files > 1000)
+    files = 1000;
+
+  memset(data, 'w', sizeof(data));
+
+  diskstat(st0);
+  t0 = uptime();
+  if((fd = open("wbbig", O_CREATE | O_RDWR)) < 0){
+    printf("wbbench: create failed\n");
+    exit(1);
+  }
+  for(i = 0; i < blocks; i++)
+    write(fd, data, sizeof(data));
+  close(fd);
+  report("large file", blocks * BSIZE / 1024, "KB", t0, st0);
+  unlink("wbbig");
+
+  diskstat(st0);
+  t0 = uptime();
+  for(i = 0; i < files; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      printf("wbbench: create %s failed\n", path);
+      exit(1);
+    }
+    write(fd, data, 100);
+    close(fd);
+  }
+  report("small files", files, "creates", t0, st0);
+  for(i = 0; i < files; i++){
+    name(path, i);
+    unlink(path);
+  }
+
+  diskstat(st0);
+  t0 = uptime();
+  if((fd = open("wbsync", O_CREATE | O_RDWR)) < 0){
+    printf("wbbench: create failed\n");
+    exit(1);
+  }
+  for(i = 0; i < NSYNC; i++){
+    write(fd, data, sizeof(data));
+    fsync(fd);
+  }
+  close(fd);
+  report("write+fsync", NSYNC, "pairs", t0, st0);
+  unlink("wbsync");
+  exit(0);
+}
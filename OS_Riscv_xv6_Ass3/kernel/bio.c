@@ -22,10 +22,12 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "slab.h"
 
 struct {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct kmem_cache bufcache;  // Buffers, allocated on demand
+  int nbuf;                    //   up to NBUF of them.
 
   // Linked list of all buffers, through prev/next.
   // Sorted by how recently the buffer was used.
@@ -36,20 +38,12 @@ struct {
 void
 binit(void)
 {
-  struct buf *b;
-
   initlock(&bcache.lock, "bcache");
+  kmem_cache_init(&bcache.bufcache, "buf", sizeof(struct buf));
 
-  // Create linked list of buffers
+  // Create empty linked list of buffers
   bcache.head.prev = &bcache.head;
   bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
 }
 
 // Look through buffer cache for block on device dev.
@@ -73,19 +67,33 @@ bget(uint dev, uint blockno)
   }
 
   // Not cached.
+  // Allocate a new buffer while there are fewer than NBUF.
+  if(bcache.nbuf < NBUF && (b = kmem_cache_alloc(&bcache.bufcache)) != 0){
+    bcache.nbuf++;
+    initsleeplock(&b->lock, "buffer");
+    b->disk = 0;
+    b->next = bcache.head.next;
+    b->prev = &bcache.head;
+    bcache.head.next->prev = b;
+    bcache.head.next = b;
+    goto found;
+  }
+
   // Recycle the least recently used (LRU) unused buffer.
   for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+    if(b->refcnt == 0)
+      goto found;
   }
   panic("bget: no buffers");
+
+found:
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
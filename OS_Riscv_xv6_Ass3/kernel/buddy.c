@@ -0,0 +1,162 @@
+// Buddy allocator for physical memory. Hands out blocks
+// of 2^order pages, aligned to their size, and merges a
+// freed block with its buddy whenever both are free.
+// kalloc.c takes single pages from here in batches;
+// kalloc_pages() takes contiguous blocks directly.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "buddy.h"
+
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PA2PG(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PG2PA(i) (KERNBASE + (uint64)(i) * PGSIZE)
+
+// Free blocks are linked through their first page.
+struct bnode {
+  struct bnode *next;
+  struct bnode *prev;
+};
+
+struct {
+  struct spinlock lock;
+  struct bnode free[BUDDY_ORDERS];  // Circular lists, by order.
+  uint nfree[BUDDY_ORDERS];
+  uchar head[NPAGE];                // 1+order if page i starts a free block, else 0.
+  uint nalloc[BUDDY_ORDERS];
+  uint nfail;
+  uint64 cycles;
+} bmem;
+
+static void
+push(struct bnode *b, int order)
+{
+  struct bnode *h = &bmem.free[order];
+
+  b->next = h->next;
+  b->prev = h;
+  h->next->prev = b;
+  h->next = b;
+  bmem.nfree[order]++;
+  bmem.head[PA2PG(b)] = 1 + order;
+}
+
+static void
+unlink(struct bnode *b, int order)
+{
+  b->prev->next = b->next;
+  b->next->prev = b->prev;
+  bmem.nfree[order]--;
+  bmem.head[PA2PG(b)] = 0;
+}
+
+void
+buddyinit(void)
+{
+  initlock(&bmem.lock, "kmem");
+  for(int i = 0; i < BUDDY_ORDERS; i++)
+    bmem.free[i].next = bmem.free[i].prev = &bmem.free[i];
+}
+
+// Allocate 2^order contiguous pages, splitting a larger
+// block if no block of that order is free.
+// Returns 0 if there is none big enough.
+void *
+buddy_alloc(int order)
+{
+  struct bnode *b;
+  uint64 t0;
+  int o;
+
+  if(order < 0 || order >= BUDDY_ORDERS)
+    return 0;
+
+  t0 = r_time();
+  acquire(&bmem.lock);
+  for(o = order; o < BUDDY_ORDERS && bmem.nfree[o] == 0; o++)
+    ;
+  if(o == BUDDY_ORDERS){
+    bmem.nfail++;
+    release(&bmem.lock);
+    return 0;
+  }
+  b = bmem.free[o].next;
+  unlink(b, o);
+  // give back the upper half until the block fits.
+  while(o > order){
+    o--;
+    push((struct bnode*)((char*)b + (PGSIZE << o)), o);
+  }
+  bmem.nalloc[order]++;
+  bmem.cycles += r_time() - t0;
+  release(&bmem.lock);
+  return (void*)b;
+}
+
+// Free a block, merging it with its buddy as long as
+// the buddy is a free block of the same order.
+// Caller must hold bmem.lock.
+static void
+bfree(void *pa, int order)
+{
+  uint64 i, j;
+
+  i = PA2PG(pa);
+  for(; order < BUDDY_ORDERS - 1; order++){
+    j = i ^ (1L << order);
+    if(j >= NPAGE || bmem.head[j] != 1 + order)
+      break;
+    unlink((struct bnode*)PG2PA(j), order);
+    i &= j;
+  }
+  push((struct bnode*)PG2PA(i), order);
+}
+
+// Free a block of 2^order pages from buddy_alloc().
+void
+buddy_free(void *pa, int order)
+{
+  if(((uint64)pa % (PGSIZE << order)) != 0 || (uint64)pa < KERNBASE ||
+     (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("buddy_free");
+
+  acquire(&bmem.lock);
+  bfree(pa, order);
+  release(&bmem.lock);
+}
+
+// Free a list of single pages, linked through each
+// page's first word, under one acquisition of the lock.
+void
+buddy_freelist(void *list)
+{
+  void *next;
+
+  acquire(&bmem.lock);
+  for(; list; list = next){
+    next = *(void**)list;
+    bfree(list, 0);
+  }
+  release(&bmem.lock);
+}
+
+// Fill in everything but st->ncached.
+void
+buddystat(struct buddystat *st)
+{
+  acquire(&bmem.lock);
+  for(int i = 0; i < BUDDY_ORDERS; i++){
+    st->nfree[i] = bmem.nfree[i];
+    st->nalloc[i] = bmem.nalloc[i];
+  }
+  st->nfail = bmem.nfail;
+  st->cycles = bmem.cycles;
+  st->nacquire = bmem.lock.nacquire;
+  st->ncontended = bmem.lock.ncontended;
+  release(&bmem.lock);
+  st->ncached = 0;
+}
@@ -0,0 +1,12 @@
+#define BUDDY_ORDERS 11  // blocks of 1, 2, 4, ... 1024 pages
+
+// Snapshot of the physical page allocator; see buddystat().
+struct buddystat {
+  uint nfree[BUDDY_ORDERS];   // Free blocks of each order.
+  uint nalloc[BUDDY_ORDERS];  // Blocks of each order handed out.
+  uint nfail;                 // buddy_alloc() calls that found no block.
+  uint ncached;               // Free pages held in hart caches (kalloc.c).
+  uint nacquire;              // Acquisitions of the allocator lock,
+  uint ncontended;            //   and how many of them had to spin.
+  uint64 cycles;              // mtime cycles spent in buddy_alloc().
+};
@@ -1,11 +1,14 @@
+struct buddystat;
 struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmem_cache;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
+struct slabstat;
 struct stat;
 struct superblock;
 
@@ -68,6 +71,25 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void            krefinc(void *);
+int             krefcount(void *);
+void            kallocstat(uint *);
+void*           kalloc_pages(int);
+void            kfree_pages(void *, int);
+int             kcached(void);
+
+// slab.c
+void            kmem_cache_init(struct kmem_cache*, char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+int             kmem_cache_stat(int, struct slabstat*);
+
+// buddy.c
+void            buddyinit(void);
+void*           buddy_alloc(int);
+void            buddy_free(void *, int);
+void            buddy_freelist(void *);
+void            buddystat(struct buddystat*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -76,6 +98,7 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -174,6 +197,9 @@ void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             cowfault(pagetable_t, uint64);
+uint64          lazyalloc(pagetable_t, uint64);
+int             uvmrss(pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -184,7 +210,7 @@ int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 
 // helper functions i added in vm.c
-void            pMemUpdater(uint64 a, pagetable_t pagetable);
+int             pMemUpdater(uint64 a, pagetable_t pagetable);
 void            swapper(pagetable_t pagetable);
 int             pageFaulter();
 int             getPage();
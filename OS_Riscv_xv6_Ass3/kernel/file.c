@@ -12,17 +12,22 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
+
+// Open files come from filecache; ftable.lock
+// protects their reference counts.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct kmem_cache filecache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  kmem_cache_init(&ftable.filecache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
@@ -31,16 +36,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = kmem_cache_alloc(&ftable.filecache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -72,6 +72,7 @@ fileclose(struct file *f)
   f->ref = 0;
   f->type = FD_NONE;
   release(&ftable.lock);
+  kmem_cache_free(&ftable.filecache, f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
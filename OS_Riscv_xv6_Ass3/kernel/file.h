@@ -18,6 +18,7 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext; // Next in itable hash chain
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
@@ -165,28 +166,31 @@ bfree(int dev, uint b)
 // multi-step atomic operations.
 //
 // The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// entries. In-memory inodes come from inodecache and are found
+// through a hash of (dev, inum); an inode is freed when its
+// last reference is dropped. Since ip->ref indicates whether
+// an entry is in use, and ip->dev and ip->inum indicate which
+// i-node an entry holds, one must hold itable.lock while using
+// any of those fields.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 61
+#define IHASH(dev, inum) (((dev) * 31 + (inum)) % NIHASH)
+
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *hash[NIHASH];   // Chains through ip->hnext.
+  struct kmem_cache inodecache;
 } itable;
 
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  kmem_cache_init(&itable.inodecache, "inode", sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -246,31 +250,31 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **h;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  h = &itable.hash[IHASH(dev, inum)];
+  for(ip = *h; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
+  // Allocate an inode entry.
+  if((ip = kmem_cache_alloc(&itable.inodecache)) == 0)
     panic("iget: no inodes");
 
-  ip = empty;
+  initsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = *h;
+  *h = ip;
   release(&itable.lock);
 
   return ip;
@@ -327,8 +331,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode table entry can
-// be recycled.
+// If that was the last reference, the inode table entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -336,6 +340,8 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  struct inode **h;
+
   acquire(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
@@ -357,7 +363,12 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
-  ip->ref--;
+  if(--ip->ref == 0){
+    for(h = &itable.hash[IHASH(ip->dev, ip->inum)]; *h != ip; h = &(*h)->hnext)
+      ;
+    *h = ip->hnext;
+    kmem_cache_free(&itable.inodecache, ip);
+  }
   release(&itable.lock);
 }
 
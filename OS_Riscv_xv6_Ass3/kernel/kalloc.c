@@ -1,6 +1,8 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// from a buddy allocator (buddy.c) that also hands out
+// contiguous multi-page blocks; see kalloc_pages().
 
 #include "types.h"
 #include "param.h"
@@ -8,6 +10,7 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "buddy.h"
 
 void freerange(void *pa_start, void *pa_end);
 
@@ -18,15 +21,42 @@ struct run {
   struct run *next;
 };
 
-struct {
+// Each hart caches free pages in a list of its own, so
+// most kalloc() and kfree() calls take only that hart's
+// lock. Pages move between the caches and the buddy
+// allocator KBATCH at a time. A hart that finds both its
+// cache and the buddy allocator empty steals half of
+// another hart's cache.
+#define KCACHE 64  // most pages a hart keeps
+#define KBATCH 32  // pages moved to or from the pool at once
+#define KBATCHORDER 5  // log2(KBATCH)
+
+struct kcache {
   struct spinlock lock;
   struct run *freelist;
-} kmem;
+  int n;                 // Pages in freelist.
+  uint nalloc;           // kalloc() calls it served.
+  uint nfree;            // kfree() calls that freed a page into it.
+  uint nrefill;          // Batches taken from the pool.
+  uint nspill;           // Batches given back to the pool.
+  uint nsteal;           // Times it stole from another hart.
+} kcache[NCPU];
+
+// Reference counts of allocated pages, which copy-on-write
+// fork shares between page tables. A page is freed when
+// its last reference is dropped. Updated atomically.
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+
+struct {
+  int count[(PHYSTOP - KERNBASE) / PGSIZE];
+} kref;
 
 void
 kinit()
 {
-  initlock(&kmem.lock, "kmem");
+  buddyinit();
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -35,31 +65,121 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    kref.count[PA2REF(p)] = 1;
     kfree(p);
+  }
+}
+
+// Move up to KBATCH pages from the buddy allocator to c:
+// the largest block no bigger than a batch, split into
+// pages. Caller must hold c->lock.
+static void
+refill(struct kcache *c)
+{
+  struct run *r;
+  char *b;
+  int o, i;
+
+  for(o = KBATCHORDER; o >= 0; o--)
+    if((b = buddy_alloc(o)) != 0)
+      break;
+  if(o < 0)
+    return;
+  for(i = 0; i < (1 << o); i++){
+    r = (struct run*)(b + i * PGSIZE);
+    r->next = c->freelist;
+    c->freelist = r;
+    c->n++;
+  }
+  c->nrefill++;
+}
+
+// Give KBATCH pages from c back to the buddy allocator.
+// Caller must hold c->lock.
+static void
+spill(struct kcache *c)
+{
+  struct run *r, *list = 0;
+  int i;
+
+  for(i = 0; i < KBATCH && (r = c->freelist) != 0; i++){
+    c->freelist = r->next;
+    c->n--;
+    r->next = list;
+    list = r;
+  }
+  buddy_freelist(list);
+  c->nspill++;
+}
+
+// Take half of the first non-empty cache other than
+// hart id's, as a list. Holds one cache lock at a time.
+static struct run*
+steal(int id)
+{
+  struct kcache *v;
+  struct run *list, *r;
+  int n;
+
+  for(v = kcache; v < &kcache[NCPU]; v++){
+    if(v == &kcache[id])
+      continue;
+    list = 0;
+    acquire(&v->lock);
+    for(n = (v->n + 1) / 2; n > 0; n--){
+      r = v->freelist;
+      v->freelist = r->next;
+      v->n--;
+      r->next = list;
+      list = r;
+    }
+    release(&v->lock);
+    if(list)
+      return list;
+  }
+  return 0;
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop a reference to the page of physical memory pointed
+// at by pa, and free it if that was the last one. pa
+// normally should have been returned by a call to kalloc().
+// (The exception is when initializing the allocator; see
+// kinit above.)
 void
 kfree(void *pa)
 {
+  struct kcache *c;
   struct run *r;
+  int n;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  n = __sync_sub_and_fetch(&kref.count[PA2REF(pa)], 1);
+  if(n < 0)
+    panic("kfree: ref");
+  if(n > 0)
+    return;
+
+#ifdef KALLOC_JUNK
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  push_off();
+  c = &kcache[cpuid()];
+  acquire(&c->lock);
+  r->next = c->freelist;
+  c->freelist = r;
+  c->n++;
+  c->nfree++;
+  if(c->n > KCACHE)
+    spill(c);
+  release(&c->lock);
+  pop_off();
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -68,15 +188,119 @@ kfree(void *pa)
 void *
 kalloc(void)
 {
-  struct run *r;
+  struct kcache *c;
+  struct run *r, *s;
+  int id;
+
+  push_off();
+  id = cpuid();
+  c = &kcache[id];
+  acquire(&c->lock);
+  if(c->freelist == 0)
+    refill(c);
+  r = c->freelist;
+  if(r){
+    c->freelist = r->next;
+    c->n--;
+    c->nalloc++;
+  }
+  release(&c->lock);
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  if(r == 0 && (r = steal(id)) != 0){
+    // keep the first stolen page, cache the rest.
+    acquire(&c->lock);
+    while((s = r->next) != 0){
+      r->next = s->next;
+      s->next = c->freelist;
+      c->freelist = s;
+      c->n++;
+    }
+    c->nsteal++;
+    c->nalloc++;
+    release(&c->lock);
+  }
+  pop_off();
 
-  if(r)
+  if(r){
+#ifdef KALLOC_JUNK
     memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
+    kref.count[PA2REF(r)] = 1;
+  }
   return (void*)r;
 }
+
+// Allocate 2^order physically contiguous pages, aligned
+// to their size, for kernel buffers larger than a page.
+// Such blocks bypass the hart caches and the reference
+// counts; free them with kfree_pages(), not kfree().
+// Returns 0 if no block is big enough.
+void *
+kalloc_pages(int order)
+{
+  return buddy_alloc(order);
+}
+
+void
+kfree_pages(void *pa, int order)
+{
+  if((char*)pa < end)
+    panic("kfree_pages");
+  buddy_free(pa, order);
+}
+
+// Number of free pages held in hart caches.
+int
+kcached(void)
+{
+  struct kcache *c;
+  int n = 0;
+
+  for(c = kcache; c < &kcache[NCPU]; c++)
+    n += c->n;
+  return n;
+}
+
+// Add a reference to an allocated page, so that it
+// takes one more kfree() to free it.
+void
+krefinc(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("krefinc");
+
+  if(__sync_fetch_and_add(&kref.count[PA2REF(pa)], 1) < 1)
+    panic("krefinc: free page");
+}
+
+// Number of references to an allocated page.
+int
+krefcount(void *pa)
+{
+  return __atomic_load_n(&kref.count[PA2REF(pa)], __ATOMIC_SEQ_CST);
+}
+
+// Fill st[0..KSTATS-1] with the allocator's counters,
+// summed over harts: kalloc() calls, pages freed, pool
+// refills, pool spills, steals, pool lock acquisitions,
+// contended pool lock acquisitions, and contended cache
+// lock acquisitions.
+void
+kallocstat(uint *st)
+{
+  struct kcache *c;
+  struct buddystat bs;
+
+  memset(st, 0, KSTATS * sizeof(uint));
+  for(c = kcache; c < &kcache[NCPU]; c++){
+    st[0] += c->nalloc;
+    st[1] += c->nfree;
+    st[2] += c->nrefill;
+    st[3] += c->nspill;
+    st[4] += c->nsteal;
+    st[7] += c->lock.ncontended;
+  }
+  buddystat(&bs);
+  st[5] = bs.nacquire;
+  st[6] = bs.ncontended;
+}
@@ -1,8 +1,7 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // i-nodes usertests holds at once
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
@@ -13,3 +12,4 @@
 #define MAXPATH      128   // maximum file path name
 #define MAX_PSYC_PAGES 16  // As required in the assignment
 #define MAX_TOTAL_PAGES 32 // As required in the assignment
+#define KSTATS        8  // counters kallocstat() reports
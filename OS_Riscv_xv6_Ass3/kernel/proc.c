@@ -289,6 +289,10 @@ userinit(void)
 }
 
 // Grow or shrink user memory by n bytes.
+// Growing only reserves the addresses; lazyalloc()
+// backs each page when the process first touches it.
+// The MAX_TOTAL_PAGES limit is still checked here, so
+// that sbrk() fails rather than a later page fault.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
@@ -298,9 +302,11 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if(sz + n >= TRAPFRAME)
       return -1;
-    }
+    if(p->pid >= 3 && PGROUNDUP(sz + n) / PGSIZE > MAX_TOTAL_PAGES)
+      return -1;
+    sz += n;
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
@@ -313,7 +319,8 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int i, pid, order = 0;
+  char *buf = 0;
   struct proc *np;
   struct proc *p = myproc();
 
@@ -327,6 +334,20 @@ fork(void)
     release(&np->lock);
     return -1;
   }
+  // alocate space for swapfile data: the whole file at
+  // once if memory allows, else as few pieces as we can.
+  // done before the child gets files, so failing is simple.
+  if(p->pid >= 3){
+    while((1 << order) < MAX_PSYC_PAGES)
+      order++;
+    while((buf = kalloc_pages(order)) == 0 && order > 0)
+      order--;
+    if(buf == 0){
+      freeproc(np);
+      release(&np->lock);
+      return -1;
+    }
+  }
   np->sz = p->sz;
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -370,19 +391,16 @@ fork(void)
     np->timerForPg = p->timerForPg; 
 
 
-    char* buf = kalloc(); // alocate space for swapfile data
-
-    for(int i=0;i<MAX_PSYC_PAGES;i++)
+    for(int off=0;off<MAX_PSYC_PAGES*PGSIZE;off+=PGSIZE<<order)
     {
-      int size = i * PGSIZE;
       // first we read from the swapfile
-      readFromSwapFile(p,buf,size,PGSIZE);
+      int n = readFromSwapFile(p,buf,off,PGSIZE<<order);
       // then we write to the swapfile
-      writeToSwapFile(np,buf,size,PGSIZE);
-
+      if(n > 0)
+        writeToSwapFile(np,buf,off,n);
     }
     // the we free the buffer
-    kfree(buf); 
+    kfree_pages(buf, order);
   }
 
   acquire(&wait_lock);
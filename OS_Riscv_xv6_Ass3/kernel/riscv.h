@@ -343,6 +343,7 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // user can access
+#define PTE_COW (1L << 8) // shared until written; see uvmcopy()
 #define PTE_PG (1L << 9) 
 #define PTE_A (1L << 6) 
 
@@ -0,0 +1,207 @@
+// Slab allocator for fixed-size kernel objects.
+//
+// A kmem_cache carves kalloc() pages (slabs) into objects
+// of one size. A slab starts with a struct slab header, its
+// free objects are linked through their first word, and an
+// object finds its slab by rounding its address down to the
+// page. Each hart keeps a magazine of free objects for each
+// cache, so most allocations and frees take no lock; a
+// magazine moves MAGSIZE/2 objects at a time to or from the
+// slabs, under the cache's lock.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "slab.h"
+#include "slabstat.h"
+
+struct slab {
+  struct slab *next;  // In c->partial.
+  struct slab *prev;
+  void *free;         // Free objects.
+  int inuse;          // Objects handed out.
+};
+
+static struct kmem_cache *caches;
+
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  size = (size + 7) & ~7;
+  if(size > PGSIZE - sizeof(struct slab))
+    panic("kmem_cache_init");
+
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - sizeof(struct slab)) / size;
+  initlock(&c->lock, name);
+  c->partial = 0;
+  c->nslab = 0;
+  c->nempty = 0;
+  c->ninuse = 0;
+  memset(c->mag, 0, sizeof(c->mag));
+  c->next = caches;
+  caches = c;
+}
+
+static void
+slab_link(struct kmem_cache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(c->partial)
+    c->partial->prev = s;
+  c->partial = s;
+}
+
+static void
+slab_unlink(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Move up to n free objects from c's slabs to objs,
+// starting a new slab when none has any left.
+// Returns how many it moved.
+static int
+slab_take(struct kmem_cache *c, void **objs, int n)
+{
+  struct slab *s;
+  char *o;
+  int i = 0, j;
+
+  acquire(&c->lock);
+  while(i < n){
+    if((s = c->partial) == 0){
+      if((s = (struct slab*)kalloc()) == 0)
+        break;
+      s->free = 0;
+      s->inuse = 0;
+      o = (char*)(s + 1);
+      for(j = 0; j < c->perslab; j++, o += c->size){
+        *(void**)o = s->free;
+        s->free = o;
+      }
+      slab_link(c, s);
+      c->nslab++;
+      c->nempty++;
+    }
+    if(s->inuse == 0)
+      c->nempty--;
+    while(i < n && s->free){
+      objs[i++] = s->free;
+      s->free = *(void**)s->free;
+      s->inuse++;
+    }
+    if(s->free == 0)
+      slab_unlink(c, s);
+  }
+  c->ninuse += i;
+  release(&c->lock);
+  return i;
+}
+
+// Return n objects to their slabs. One empty slab is
+// kept for the next slab_take(); others go back to kfree().
+static void
+slab_put(struct kmem_cache *c, void **objs, int n)
+{
+  struct slab *s;
+  int i;
+
+  acquire(&c->lock);
+  for(i = 0; i < n; i++){
+    s = (struct slab*)PGROUNDDOWN((uint64)objs[i]);
+    if(s->free == 0)
+      slab_link(c, s);
+    *(void**)objs[i] = s->free;
+    s->free = objs[i];
+    if(--s->inuse == 0){
+      if(c->nempty > 0){
+        slab_unlink(c, s);
+        kfree((void*)s);
+        c->nslab--;
+      } else {
+        c->nempty++;
+      }
+    }
+  }
+  c->ninuse -= n;
+  release(&c->lock);
+}
+
+// Allocate an object of c->size bytes. Its contents
+// are undefined. Returns 0 if memory is exhausted.
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj = 0;
+  uint64 t0;
+
+  t0 = r_time();
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0)
+    m->n = slab_take(c, m->obj, MAGSIZE / 2);
+  if(m->n > 0){
+    obj = m->obj[--m->n];
+    m->nalloc++;
+    m->cycles += r_time() - t0;
+  }
+  pop_off();
+  return obj;
+}
+
+// Free an object from kmem_cache_alloc(c).
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    slab_put(c, &m->obj[MAGSIZE / 2], MAGSIZE / 2);
+    m->n = MAGSIZE / 2;
+  }
+  m->obj[m->n++] = obj;
+  pop_off();
+}
+
+// Fill in st for the i'th cache.
+// Returns 0, or -1 if there are fewer caches.
+int
+kmem_cache_stat(int i, struct slabstat *st)
+{
+  struct kmem_cache *c;
+  struct magazine *m;
+
+  for(c = caches; c && i > 0; c = c->next)
+    i--;
+  if(c == 0)
+    return -1;
+
+  safestrcpy(st->name, c->name, sizeof(st->name));
+  st->size = c->size;
+  st->perslab = c->perslab;
+  st->nalloc = 0;
+  st->cycles = 0;
+  for(m = c->mag; m < &c->mag[NCPU]; m++){
+    st->nalloc += m->nalloc;
+    st->cycles += m->cycles;
+  }
+  acquire(&c->lock);
+  st->nslab = c->nslab;
+  st->ninuse = c->ninuse;
+  release(&c->lock);
+  return 0;
+}
@@ -0,0 +1,24 @@
+#define MAGSIZE 16  // free objects a hart caches per kmem_cache
+
+// A hart's cache of free objects.
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+  uint nalloc;             // kmem_cache_alloc() calls served.
+  uint64 cycles;           // mtime cycles they took.
+};
+
+// Objects of one size, carved out of kalloc() pages.
+// See slab.c.
+struct kmem_cache {
+  char *name;
+  uint size;               // Object size, rounded up to 8 bytes.
+  uint perslab;            // Objects per slab page.
+  struct spinlock lock;    // Protects the fields below.
+  struct slab *partial;    // Slabs with free objects.
+  uint nslab;              // Slab pages held.
+  uint nempty;             // Slabs with no objects handed out.
+  uint ninuse;             // Objects out of the slabs, in magazines or in use.
+  struct magazine mag[NCPU];
+  struct kmem_cache *next; // All caches, for kmem_cache_stat().
+};
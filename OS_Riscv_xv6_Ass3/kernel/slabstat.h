@@ -0,0 +1,10 @@
+// One kmem_cache's counters; see slabstat().
+struct slabstat {
+  char name[16];
+  uint size;       // Object size in bytes.
+  uint perslab;    // Objects per slab page.
+  uint nslab;      // Slab pages held.
+  uint ninuse;     // Objects out of the slabs.
+  uint nalloc;     // Allocations.
+  uint64 cycles;   // mtime cycles spent in them.
+};
@@ -5,5 +5,9 @@ struct spinlock {
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // For contention statistics, updated with the lock held:
+  uint nacquire;     // Times acquired.
+  uint ncontended;   // Times acquire() had to spin.
 };
 
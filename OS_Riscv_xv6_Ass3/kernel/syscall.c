@@ -101,6 +101,10 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_rss(void);
+extern uint64 sys_kmemstat(void);
+extern uint64 sys_buddystat(void);
+extern uint64 sys_slabstat(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -126,6 +130,10 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_rss]     sys_rss,
+[SYS_kmemstat] sys_kmemstat,
+[SYS_buddystat] sys_buddystat,
+[SYS_slabstat] sys_slabstat,
 };
 
 void
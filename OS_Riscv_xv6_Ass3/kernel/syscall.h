@@ -20,3 +20,7 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_rss    22
+#define SYS_kmemstat 23
+#define SYS_buddystat 24
+#define SYS_slabstat 25
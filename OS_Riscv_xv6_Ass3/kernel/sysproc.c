@@ -5,6 +5,8 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "buddy.h"
+#include "slabstat.h"
 
 uint64
 sys_exit(void)
@@ -89,3 +91,57 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// return how many of the process's pages are
+// resident in memory; sbrk() reserves pages lazily.
+uint64
+sys_rss(void)
+{
+  struct proc *p = myproc();
+
+  return uvmrss(p->pagetable, p->sz);
+}
+
+// copy the page allocator's counters to st, an
+// array of KSTATS uints; see kallocstat().
+uint64
+sys_kmemstat(void)
+{
+  uint64 st;
+  uint buf[KSTATS];
+
+  argaddr(0, &st);
+  kallocstat(buf);
+  return copyout(myproc()->pagetable, st, (char*)buf, sizeof(buf));
+}
+
+// copy a snapshot of the buddy allocator to st,
+// a struct buddystat.
+uint64
+sys_buddystat(void)
+{
+  uint64 st;
+  struct buddystat bs;
+
+  argaddr(0, &st);
+  buddystat(&bs);
+  bs.ncached = kcached();
+  return copyout(myproc()->pagetable, st, (char*)&bs, sizeof(bs));
+}
+
+// copy the counters of up to n slab caches to st,
+// an array of struct slabstat. returns how many.
+uint64
+sys_slabstat(void)
+{
+  uint64 st;
+  int n, i;
+  struct slabstat ss;
+
+  argaddr(0, &st);
+  argint(1, &n);
+  for(i = 0; i < n && kmem_cache_stat(i, &ss) == 0; i++)
+    if(copyout(myproc()->pagetable, st + i * sizeof(ss), (char*)&ss, sizeof(ss)) < 0)
+      return -1;
+  return i;
+}
@@ -167,7 +167,8 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 }
 
 // Remove npages of mappings starting from va. va must be
-// page-aligned. The mappings must exist.
+// page-aligned. Pages growproc() added but the process
+// never touched have no mapping and are skipped.
 // Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
@@ -182,9 +183,9 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
     if((pte = walk(pagetable, a, 0)) == 0)
-      panic("uvmunmap: walk");
+      continue;
     if(((*pte & PTE_V) == 0) && ((*pte & PTE_PG) == 0))
-      panic("uvmunmap: not mapped");
+      continue;
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
     if((*pte & PTE_V) && do_free){
@@ -288,8 +289,10 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
     }
 
     //here we add a new page to the proc pages 
-    if (p->pid >= 3)
-      pMemUpdater(a,pagetable); 
+    if (p->pid >= 3 && pMemUpdater(a,pagetable) < 0){
+      uvmdealloc(pagetable, a + PGSIZE, oldsz);
+      return 0;
+    }
   
   }
 
@@ -297,6 +300,53 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 }
 
 
+// Back the page at va with zeroed memory on first touch.
+// growproc() only moves p->sz; this allocates what the
+// process actually uses, from pageFaulter() or when the
+// kernel copies to or from the page.
+// returns the page's physical address, or 0 if va is
+// not an unbacked page of the current process or memory
+// is exhausted.
+uint64
+lazyalloc(pagetable_t pagetable, uint64 va)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  char *mem;
+
+  va = PGROUNDDOWN(va);
+  if(pagetable != p->pagetable || va >= p->sz)
+    return 0;
+  if((pte = walk(pagetable, va, 0)) != 0 && (*pte & (PTE_V|PTE_PG)))
+    return 0;
+  if((mem = kalloc()) == 0)
+    return 0;
+  memset(mem, 0, PGSIZE);
+  if(mappages(pagetable, va, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_U) != 0){
+    kfree(mem);
+    return 0;
+  }
+  if(p->pid >= 3 && pMemUpdater(va, pagetable) < 0){
+    uvmunmap(pagetable, va, 1, 1);
+    return 0;
+  }
+  return (uint64)mem;
+}
+
+// Count the pages of [0, sz) that are resident in memory.
+int
+uvmrss(pagetable_t pagetable, uint64 sz)
+{
+  pte_t *pte;
+  uint64 a;
+  int n = 0;
+
+  for(a = 0; a < sz; a += PGSIZE)
+    if((pte = walk(pagetable, a, 0)) != 0 && (*pte & PTE_V))
+      n++;
+  return n;
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -345,34 +395,39 @@ uvmfree(pagetable_t pagetable, uint64 sz)
   freewalk(pagetable);
 }
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, share
+// its memory with a child's page table.
+// Resident pages are mapped into both, writable ones
+// read-only and PTE_COW, until cowfault() copies them.
+// Pages out in the swap file keep their PTE_PG entry;
+// fork() copies the swap file itself.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
-  pte_t *pte;
+  pte_t *pte, *npte;
   uint64 pa, i;
   uint flags;
-  char *mem;
 
   for(i = 0; i < sz; i += PGSIZE){
     if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
+      continue;
     if((*pte & PTE_V) == 0 && (*pte & PTE_PG) == 0)
-      panic("uvmcopy: page not present");
+      continue;
+    if((*pte & PTE_V) == 0){
+      if((npte = walk(new, i, 1)) == 0)
+        goto err;
+      *npte = PTE_FLAGS(*pte);
+      continue;
+    }
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
+    if(mappages(new, i, PGSIZE, pa, flags) != 0)
       goto err;
-    }
+    krefinc((void*)pa);
   }
   return 0;
 
@@ -381,6 +436,40 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return -1;
 }
 
+// Give pagetable a private, writable copy of the
+// copy-on-write page at va, after a store to it or
+// before copyout(). The last sharer takes the page
+// over without copying.
+// returns 0 on success, -1 if va is not a
+// copy-on-write page or memory is exhausted.
+int
+cowfault(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  uint flags;
+  char *mem;
+
+  if(va >= MAXVA)
+    return -1;
+  if((pte = walk(pagetable, va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_V|PTE_U|PTE_COW)) != (PTE_V|PTE_U|PTE_COW))
+    return -1;
+  pa = PTE2PA(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefcount((void*)pa) == 1){
+    *pte = PA2PTE(pa) | flags;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | flags;
+    kfree((void*)pa);
+  }
+  sfence_vma();
+  return 0;
+}
 
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
@@ -402,11 +491,20 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
+    if(va0 >= MAXVA)
+      return -1;
+    pte = walk(pagetable, va0, 0);
+    if(pte && (*pte & PTE_COW) && cowfault(pagetable, va0) < 0)
+      return -1;
     pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if(pa0 == 0 && (pa0 = lazyalloc(pagetable, va0)) == 0)
+      return -1;
+    // a read-only page that is not COW, such as text.
+    if((*walk(pagetable, va0, 0) & PTE_W) == 0)
       return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
@@ -431,7 +529,7 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
     pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if(pa0 == 0 && (pa0 = lazyalloc(pagetable, va0)) == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
     if(n > len)
@@ -458,7 +556,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
     pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if(pa0 == 0 && (pa0 = lazyalloc(pagetable, va0)) == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
     if(n > max)
@@ -595,8 +693,18 @@ int pageFaulter(){
   uint64 virt = r_stval();
   uint64 sw = PGROUNDDOWN(virt);
   //
+  if(virt >= MAXVA)
+    return 0;
   pte_t* pte = walk(p->pagetable, r_stval(), 0);
 
+  // a store to a page fork() shares copy-on-write
+  if(r_scause() == 15 && pte && (*pte & PTE_V) && (*pte & PTE_COW))
+    return cowfault(p->pagetable, sw) == 0 ? 3 : 0;
+
+  // first touch of a page growproc() added
+  if(pte == 0 || (*pte & (PTE_V|PTE_PG)) == 0)
+    return lazyalloc(p->pagetable, sw) ? 3 : 0;
+
   // this means a segmentation fault
   if(!(*pte & PTE_PG))
     return 0;
@@ -721,9 +829,13 @@ void swapper(pagetable_t pagetable){
 }
 
 // this is a helper function that adds a new page that was in the uvmalloc() function to the proccess's pages stack
-void pMemUpdater(uint64 a, pagetable_t pagetable){
+// returns -1, leaving the page untracked, if the process already has MAX_TOTAL_PAGES pages
+int pMemUpdater(uint64 a, pagetable_t pagetable){
   struct proc *p = myproc();
 
+  if(p->numOfPagesInSwapfile + p->numOfPagesInMem == MAX_TOTAL_PAGES)
+    return -1;
+
   // if it is full - chose a page to swap out instead
   if(p->numOfPagesInMem == MAX_PSYC_PAGES)
     swapper(pagetable);
@@ -762,4 +874,5 @@ void pMemUpdater(uint64 a, pagetable_t pagetable){
   // here we check if  it  out to secondary storage
   *pte &= ~PTE_PG;
   
+  return 0;
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+// Runs a grind.c-style random mix of heap growth, forks,
+// pipes and file writes in several processes at once, then
+// reports the buddy allocator's average allocation latency
+// and how fragmented free memory was left.
+//
+// usage: buddybench [procs] [iters]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/buddy.h"
+#include "user/user.h"
+
+// from FreeBSD; see grind.c.
+int
+do_rand(unsigned long *ctx)
+{
+  long hi, lo, x;
+
+  x = (*ctx % 0x7ffffffe) + 1;
+  hi = x / 127773;
+  lo = x % 127773;
+  x = 16807 * lo - 2836 * hi;
+  if (x < 0)
+    x += 0x7fffffff;
+  x--;
+  *ctx = x;
+  return (x);
+}
+
+void
+go(int which, int iters)
+{
+  unsigned long seed = which + 1;
+  char name[] = "bbX";
+  char buf[512];
+  char *mem;
+  int i, j, n, fd, fds[2];
+
+  name[2] = 'a' + which;
+  for(i = 0; i < iters; i++){
+    switch(do_rand(&seed) % 4){
+    case 0:
+      // grow the heap by a few pages and touch them.
+      n = 1 + do_rand(&seed) % 8;
+      if((mem = sbrk(n * 4096)) == (char*)-1)
+        break;
+      for(j = 0; j < n; j++)
+        mem[j * 4096] = i;
+      sbrk(-n * 4096);
+      break;
+    case 1:
+      if(fork() == 0)
+        exit(0);
+      wait(0);
+      break;
+    case 2:
+      if(pipe(fds) < 0)
+        break;
+      write(fds[1], buf, sizeof(buf));
+      read(fds[0], buf, sizeof(buf));
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    case 3:
+      if((fd = open(name, O_CREATE|O_RDWR)) < 0)
+        break;
+      write(fd, buf, sizeof(buf));
+      close(fd);
+      unlink(name);
+      break;
+    }
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct buddystat st0, st1;
+  int procs = 4, iters = 200;
+  int i, o, t0, t1;
+  uint nalloc, nfree, big;
+
+  if(argc > 1)
+    procs = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+  if(procs > 26)
+    procs = 26;
+
+  buddystat(&st0);
+  t0 = uptime();
+  for(i = 0; i < procs; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("buddybench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      go(i, iters);
+  }
+  for(i = 0; i < procs; i++)
+    wait(0);
+  t1 = uptime();
+  buddystat(&st1);
+
+  nalloc = 0;
+  for(o = 0; o < BUDDY_ORDERS; o++)
+    nalloc += st1.nalloc[o] - st0.nalloc[o];
+  printf("%d procs x %d ops: %d ticks, %d buddy allocations, %d failed\n",
+         procs, iters, t1 - t0, nalloc, st1.nfail - st0.nfail);
+  if(nalloc)
+    printf("average buddy_alloc(): %d ns\n",
+           (int)((st1.cycles - st0.cycles) * 100 / nalloc));
+
+  // unusable free space index: the share of free pages
+  // in blocks too small for an allocation of each order.
+  nfree = st1.ncached;
+  for(o = 0; o < BUDDY_ORDERS; o++)
+    nfree += st1.nfree[o] << o;
+  printf("%d free pages, %d in hart caches\n", nfree, st1.ncached);
+  printf("order  free-blocks  unusable%%\n");
+  for(o = 0; o < BUDDY_ORDERS; o++){
+    big = o == 0 ? st1.ncached : 0;
+    for(i = o; i < BUDDY_ORDERS; i++)
+      big += st1.nfree[i] << i;
+    printf("%d  %d  %d\n", o, st1.nfree[o],
+           nfree ? (int)((nfree - big) * 100 / nfree) : 0);
+  }
+  exit(0);
+}
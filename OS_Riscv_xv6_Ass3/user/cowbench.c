@@ -0,0 +1,62 @@
+// Times fork+exec from parents of growing size. With
+// copy-on-write fork the child shares the parent's pages
+// until exec replaces them, so the cost should stay flat
+// instead of growing with the parent.
+//
+// usage: cowbench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define KB 1024
+#define MB (1024*1024)
+
+int sizes[] = { 64*KB, 1*MB, 16*MB, 64*MB };
+
+int
+main(int argc, char *argv[])
+{
+  char *args[] = { "cowbench", "-exit", 0 };
+  int rounds = 20;
+  int i, j, t0, t1, pid;
+  char *mem;
+
+  // the child's exec lands here and exits at once.
+  if(argc > 1 && strcmp(argv[1], "-exit") == 0)
+    exit(0);
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    mem = sbrk(sizes[i]);
+    if(mem == (char*)-1){
+      printf("%d KB parent: sbrk failed (at most %d pages per process)\n",
+             sizes[i] / KB, MAX_TOTAL_PAGES);
+      continue;
+    }
+    // touch every page so the parent owns real memory.
+    for(j = 0; j < sizes[i]; j += 4096)
+      mem[j] = j;
+
+    t0 = uptime();
+    for(j = 0; j < rounds; j++){
+      pid = fork();
+      if(pid < 0){
+        printf("cowbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        exec(args[0], args);
+        printf("cowbench: exec failed\n");
+        exit(1);
+      }
+      wait(0);
+    }
+    t1 = uptime();
+    printf("%d KB parent: %d fork+exec in %d ticks, %d us each\n",
+           sizes[i] / KB, rounds, t1 - t0, (t1 - t0) * 100000 / rounds);
+    sbrk(-sizes[i]);
+  }
+  exit(0);
+}
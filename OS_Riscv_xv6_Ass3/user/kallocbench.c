@@ -0,0 +1,77 @@
+// Page allocator stress: 1..n workers at once grow, touch
+// and shrink their heap and fork short-lived children.
+// Reports pages allocated per second and how often the
+// allocator's locks were contended. Run it under
+// make CPUS=1 .. CPUS=8 to see how it scales with harts.
+//
+// usage: kallocbench [maxworkers] [rounds]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define NPAGES 8    // heap pages per round; stays resident
+#define FORKEVERY 16
+
+void
+worker(int rounds)
+{
+  char *mem;
+  int i, j;
+
+  for(i = 0; i < rounds; i++){
+    if((mem = sbrk(NPAGES * 4096)) == (char*)-1){
+      printf("kallocbench: sbrk failed\n");
+      exit(1);
+    }
+    for(j = 0; j < NPAGES; j++)
+      mem[j * 4096] = i;
+    sbrk(-NPAGES * 4096);
+    if(i % FORKEVERY == 0){
+      if(fork() == 0)
+        exit(0);
+      wait(0);
+    }
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint st0[KSTATS], st1[KSTATS];
+  int maxworkers = 8, rounds = 500;
+  int w, i, t0, t1, pages;
+
+  if(argc > 1)
+    maxworkers = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+
+  printf("workers  pages/sec  refills  spills  steals  pool-contended  cache-contended\n");
+  for(w = 1; w <= maxworkers; w++){
+    kmemstat(st0);
+    t0 = uptime();
+    for(i = 0; i < w; i++){
+      int pid = fork();
+      if(pid < 0){
+        printf("kallocbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0)
+        worker(rounds);
+    }
+    for(i = 0; i < w; i++)
+      wait(0);
+    t1 = uptime();
+    kmemstat(st1);
+
+    pages = st1[0] - st0[0];
+    if(t1 == t0)
+      t1 = t0 + 1;
+    printf("%d  %d  %d  %d  %d  %d/%d  %d\n", w, pages * 10 / (t1 - t0),
+           st1[2] - st0[2], st1[3] - st0[3], st1[4] - st0[4],
+           st1[6] - st0[6], st1[5] - st0[5], st1[7] - st0[7]);
+  }
+  exit(0);
+}
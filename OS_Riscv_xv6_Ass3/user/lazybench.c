@@ -0,0 +1,62 @@
+// Times an sbrk() of all the pages a process may still have
+// under MAX_TOTAL_PAGES, followed by a sparse touch of the new
+// memory, and reports how many pages were resident after each
+// step. sbrk() only reserves the addresses; a page is allocated
+// and zeroed when it is first touched.
+//
+// usage: lazybench [stride-pages]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+int
+main(int argc, char *argv[])
+{
+  int stride = 2;
+  int t0, t1, t2, rss0, rss1, rss2, size, n, i;
+  char *mem;
+
+  if(argc > 1)
+    stride = atoi(argv[1]);
+  if(stride < 1){
+    printf("lazybench: stride must be at least 1 page\n");
+    exit(1);
+  }
+  mem = sbrk(0);
+  size = MAX_TOTAL_PAGES * PGSIZE - ((uint64)mem + PGSIZE - 1) / PGSIZE * PGSIZE;
+  if(size <= 0){
+    printf("lazybench: already at MAX_TOTAL_PAGES (%d)\n", MAX_TOTAL_PAGES);
+    exit(1);
+  }
+  n = (size / PGSIZE + stride - 1) / stride;
+
+  rss0 = rss();
+  t0 = uptime();
+  mem = sbrk(size);
+  t1 = uptime();
+  if(mem == (char*)-1){
+    printf("lazybench: sbrk failed\n");
+    exit(1);
+  }
+  rss1 = rss();
+  for(i = 0; i < n; i++)
+    mem[i * stride * PGSIZE] = i;
+  t2 = uptime();
+  rss2 = rss();
+
+  printf("sbrk(%d KB): %d ticks, resident pages %d -> %d\n",
+         size / 1024, t1 - t0, rss0, rss1);
+  printf("touch %d pages, one per %d: %d ticks, resident pages %d\n",
+         n, stride, t2 - t1, rss2);
+
+  for(i = 0; i < n; i++)
+    if(mem[i * stride * PGSIZE] != (char)i){
+      printf("lazybench: page %d lost its contents\n", i);
+      exit(1);
+    }
+  sbrk(-size);
+  exit(0);
+}
@@ -1,4 +1,6 @@
 struct stat;
+struct buddystat;
+struct slabstat;
 
 // system calls
 int fork(void);
@@ -22,6 +24,10 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int rss(void);
+int kmemstat(uint*);
+int buddystat(struct buddystat*);
+int slabstat(struct slabstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -36,3 +36,7 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("rss");
+entry("kmemstat");
+entry("buddystat");
+entry("slabstat");